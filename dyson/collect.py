@@ -31,6 +31,8 @@ class WeightEstimator():
     def MergeFromDict(self, WeightDict):
         """add data from another WeightEstimator, work even if order WeightDict is smaller than MaxOrder"""
         datamat=WeightDict[self.__Weight.Name]
+        if datamat['WeightAccu'].shape[1]!=self.__Weight.NSpin:
+            datamat['WeightAccu']=self.__Weight.ExpandConservedSpins(datamat['WeightAccu'])
         if hasattr(self, "Norm"):
             self.WeightAccu+=datamat['WeightAccu']
             self.NormAccu+=datamat['NormAccu']
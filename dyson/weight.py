@@ -160,6 +160,17 @@ class Weight():
         self.SpaceDomain=SpaceDomain
         self.TimeDomain=TimeDomain
         
+    def ExpandConservedSpins(self, Data):
+        """Data is an estimator array (order first) from a simulator built with SPIN_CONSERVED:
+           its first spin axis holds the channels of GetConservedSpinTuple("FourSpins") and the second
+           spin axis has one element. Return it with both spin axes of size NSpin."""
+        Shape=list(Data.shape)
+        Shape[1], Shape[3]=self.NSpin, self.NSpin
+        Full=np.zeros(Shape, dtype=complex)
+        for channel, s in enumerate(self.Map.GetConservedSpinTuple("FourSpins")):
+            Full[:,self.Map.Spin2Index(*s[IN]),:,self.Map.Spin2Index(*s[OUT]),...]=Data[:,channel,:,0,...]
+        return Full
+
     def Copy(self):
         """return a deep copy of Weight instance"""
         import copy
@@ -6,7 +6,12 @@ MonteCarlo={
     "__IsCluster" : False, 
     "__AutoRun" : True,
     },
-"Job": {"Sample" : 100000000}  ##0.8 min for 1000000(*1000) Samples in MC
+"Job": {"Sample" : 100000000,  ##0.8 min for 1000000(*1000) Samples in MC
+        "Chains" : 1,  ##Markov chains (threads) in each MC process, sharing one copy of G/W
+        "BetaLadder" : [],  ##parallel tempering replicas, Beta of each relative to Beta, e.g. [1.0, 0.8, 0.6]; [] to disable
+        "AsyncMeasure" : False,  ##accumulate Sigma/Polar on a second thread, single chain only
+        "PipelineCPUs" : [],  ##cpus of the Markov and the measurement thread of AsyncMeasure, e.g. [0, 1]; [] to leave them to the kernel
+        "ConfigPool" : ""}  ##directory of thermalized diagrams shared by jobs to skip Toss, e.g. "pool"; "" to disable
 }
 Dyson={
 "Control": {
@@ -36,7 +41,12 @@ Common={
     #"Name": "Honeycomb", "NSublat": 2,
     #"Name": "Kagome", "NSublat": 3,
     #"Name": "Triangular", "NSublat": 1,
-    "L": [8,8]
+    "L": [8,8],
+    #True to store G, W, Sigma and Polar once per class of site pairs related by the lattice symmetry
+    "PointGroup": False,
+    #W is kept only within WCutoff unit cells, or where it is above WThreshold times its largest value; negative to keep W everywhere
+    "WCutoff": -1.0,
+    "WThreshold": -1.0
 
     #3D lattice
     #"Name": "Cubic", "NSublat": 1,
@@ -59,7 +69,9 @@ MonteCarlo["Markov"]={
     "OrderReWeight" : [100.0, 0.5, 1.0, 0.1, 0.05, 0.05, 0.01, 0.005],
     "WormSpaceReweight" : 0.05,
     "PolarReweight" : 2.0,
-    "OrderTimeRatio" : [1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0],
+    "TauTrials" : 1,  ##candidate times tried at once when a vertex is moved in tau
+    "OrderTimeRatio" : [1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0],  ##importance of the error of each order
+    "CostReWeight" : False,  ##tune OrderReWeight with the measured cost and error of each order instead of the number of configurations
     #"Timer": {
         #"PrinterTimer": 300,
         #"DiskWriterTimer": 300,
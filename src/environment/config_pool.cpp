@@ -0,0 +1,119 @@
+//
+//  config_pool.cpp
+//  Feynman_Simulator
+//
+
+#include "config_pool.h"
+#include "module/parameter/parameter.h"
+#include "job/job.h"
+#include "module/diagram/diagram.h"
+#include "utility/dictionary.h"
+#include <cstdio>
+#include <dirent.h>
+#include <functional>
+#include <vector>
+
+using namespace std;
+
+//snapshots kept by every job, the older ones are overwritten
+const int MaxSnapshots = 8;
+
+ConfigPool::ConfigPool(const para::Job& Job)
+    : _Dir(Job.ConfigPool)
+    , _PID(Job.PID)
+    , _Deposits(0)
+{
+    if (!IsEnabled())
+        return;
+    //the Hamiltonian is only known to the python side, so the Model section is hashed as it is
+    Dictionary input;
+    input.Load(Job.InputFile);
+    auto para = input.Get<Dictionary>("Para");
+    if (para.HasKey("Model"))
+        _Model = para.Get<Dictionary>("Model").PrettyString();
+}
+
+string ConfigPool::_Tag(const para::ParaMC& Para)
+{
+    string model = ToString(Para.Lat.Size) + " " + ToString(Para.NSublat) + " " + ToString(Para.MaxTauBin)
+                   + " " + ToString(Para.Order) + " " + ToString(Para.Beta, 0, 8)
+                   + " " + ToString(Para.WCutoff) + " " + ToString(Para.WThreshold) + " " + _Model;
+    //build options which change the weights or the layout of a diagram
+    model += " D" + ToString(D) + " O" + ToString(MAX_ORDER);
+#ifdef SPIN_CONSERVED
+    model += " SPIN_CONSERVED";
+#endif
+#ifdef SINGLE_PRECISION_WEIGHT
+    model += " SINGLE_PRECISION_WEIGHT";
+#endif
+#ifdef REAL_WEIGHT
+    model += " REAL_WEIGHT";
+#endif
+    return ToString(hash<string>()(model));
+}
+
+//the tag covers the dimension, MAX_DIAGRAM_ORDER and build options, so the layout of a snapshot never changes for it
+bool WriteSnapshot(const string& file, const diag::DiagramSnapshot& snap)
+{
+    FILE* f = fopen(file.c_str(), "wb");
+    if (f == nullptr)
+        return false;
+    bool done = (fwrite(&snap, sizeof(snap), 1, f) == 1);
+    return (fclose(f) == 0) && done;
+}
+
+bool ReadSnapshot(const string& file, diag::DiagramSnapshot& snap)
+{
+    FILE* f = fopen(file.c_str(), "rb");
+    if (f == nullptr)
+        return false;
+    bool done = (fread(&snap, sizeof(snap), 1, f) == 1);
+    fclose(f);
+    return done;
+}
+
+void ConfigPool::Deposit(const diag::DiagramSnapshot& Snap, const para::ParaMC& Para)
+{
+    string name = _Tag(Para) + "_" + ToString(_PID) + "_" + ToString(_Deposits % MaxSnapshots) + ".snap";
+    //write to a hidden file first, so that other jobs never read a half-written snapshot
+    if (!WriteSnapshot(_Dir + "/_" + name, Snap) || rename((_Dir + "/_" + name).c_str(), (_Dir + "/" + name).c_str()) != 0) {
+        LOG_WARNING("Fail to deposit the configuration into " << _Dir);
+        return;
+    }
+    _Deposits++;
+}
+
+bool ConfigPool::Withdraw(diag::DiagramSnapshot& Snap, para::ParaMC& Para)
+{
+    DIR* dir = opendir(_Dir.c_str());
+    if (dir == nullptr) {
+        LOG_WARNING("Can not open the config pool " << _Dir);
+        return false;
+    }
+    string prefix = _Tag(Para) + "_";
+    vector<string> snapshots;
+    while (dirent* entry = readdir(dir)) {
+        string name = entry->d_name;
+        if (name.compare(0, prefix.size(), prefix) == 0 && name.size() > 5 && name.compare(name.size() - 5, 5, ".snap") == 0)
+            snapshots.push_back(name);
+    }
+    closedir(dir);
+    //claim a snapshot by renaming it to a hidden file, so that no two jobs start from the same one
+    while (!snapshots.empty()) {
+        int i = Para.RNG.irn(0, int(snapshots.size()) - 1);
+        string name = _Dir + "/" + snapshots[i];
+        string claimed = _Dir + "/_" + ToString(_PID) + "_" + snapshots[i];
+        snapshots.erase(snapshots.begin() + i);
+        if (rename(name.c_str(), claimed.c_str()) != 0)
+            continue; //taken by another job
+        bool loaded = ReadSnapshot(claimed, Snap);
+        if (!loaded)
+            LOG_WARNING("Fail to read the snapshot " << name);
+        remove(claimed.c_str());
+        if (loaded) {
+            LOG_INFO("Start from the snapshot " << name);
+            return true;
+        }
+    }
+    return false;
+}
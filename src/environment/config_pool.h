@@ -0,0 +1,44 @@
+//
+//  config_pool.h
+//  Feynman_Simulator
+//
+
+#ifndef __Feynman_Simulator__config_pool__
+#define __Feynman_Simulator__config_pool__
+
+#include <string>
+
+namespace diag {
+class DiagramSnapshot;
+}
+namespace para {
+class ParaMC;
+class Job;
+}
+
+/**
+*  A directory of thermalized diagrams shared by all the jobs of one model, so that a new job
+*  can start from one of them instead of thermalizing from scratch.
+*  Every snapshot is a diag::DiagramSnapshot written as it is into <Tag>_<PID>_<Slot>.snap, where Tag
+*  hashes everything the configuration space, the weights and the layout of a snapshot depend on
+*  (lattice, MaxTauBin, Order, Beta, the Model section of the input file and the build options).
+*/
+class ConfigPool {
+public:
+    ConfigPool(const para::Job&);
+    bool IsEnabled() const { return !_Dir.empty(); }
+
+    //overwrite the oldest of the MaxSnapshots slots of the job
+    void Deposit(const diag::DiagramSnapshot&, const para::ParaMC&);
+    //take a random snapshot with the tag of Para out of the pool, return false if there is none
+    bool Withdraw(diag::DiagramSnapshot&, para::ParaMC& Para);
+
+private:
+    std::string _Dir;
+    std::string _Model;
+    int _PID;
+    int _Deposits;
+    std::string _Tag(const para::ParaMC&);
+};
+
+#endif /* defined(__Feynman_Simulator__config_pool__) */
@@ -8,6 +8,7 @@
 
 #include "environment.h"
 #include "utility/dictionary.h"
+#include <climits>
 
 using namespace std;
 using namespace para;
@@ -21,7 +22,9 @@ const string EstimatorsKey = "Estimators";
 EnvMonteCarlo::EnvMonteCarlo(const para::Job& job, bool IsAllTauSymmetric)
     : Job(job)
     , Weight(IsAllTauSymmetric)
+    , _Pool(job)
 {
+    MarkovMonitor.Chain = &Markov;
 }
 
 bool EnvMonteCarlo::BuildNew()
@@ -86,6 +89,7 @@ bool EnvMonteCarlo::Load()
 void EnvMonteCarlo::Save()
 {
     LOG_INFO("Start saving data...");
+    MarkovMonitor.Flush();
     Dictionary para_;
     para_[ParaKey] = Para.ToDict();
     para_[ConfigKey] = Diag.ToDict();
@@ -97,6 +101,31 @@ void EnvMonteCarlo::Save()
     LOG_INFO("Saving data is done!");
 }
 
+bool EnvMonteCarlo::WarmStart()
+{
+    if (!_Pool.IsEnabled())
+        return false;
+    diag::DiagramSnapshot snap;
+    if (!_Pool.Withdraw(snap, Para))
+        return false;
+    //FromSnapshot recomputes all the weights with the current G/W
+    if (!Diag.FromSnapshot(snap) || Equal(Diag.Weight, Amplitude(0.0)) || !Diag.CheckDiagram()) {
+        LOG_WARNING("The snapshot is not valid with the current weights, thermalize from a new diagram!");
+        Diag.BuildNew(Para.Lat, *Weight.G, *Weight.W);
+        return false;
+    }
+    return true;
+}
+
+void EnvMonteCarlo::DepositConfig()
+{
+    if (!_Pool.IsEnabled())
+        return;
+    diag::DiagramSnapshot snap;
+    Diag.ToSnapshot(snap);
+    _Pool.Deposit(snap, Para);
+}
+
 void EnvMonteCarlo::DeleteSavedFiles()
 {
     system(("rm " + Job.ParaFile).c_str());
@@ -143,14 +172,79 @@ bool EnvMonteCarlo::ListenToMessage()
         LOG_WARNING("Annealing Failed!");
         return false;
     }
+    MarkovMonitor.Flush();
     Para.UpdateWithMessage(Message_);
     Weight.FromDict(weight_, weight::GW, Para);
+    _Anneal(Message_);
+    return true;
+}
+
+void EnvMonteCarlo::_Anneal(const Message& Message_)
+{
+    LastMessage = Message_;
     Weight.Anneal(Para);
     Diag.Reset(Para.Lat, *Weight.G, *Weight.W);
     Markov.Reset(Para, Diag, Weight);
     MarkovMonitor.Reset(Para, Diag, Weight);
-    MarkovMonitor.SqueezeStatistics(Message_.SqueezeFactor);
-    LOG_INFO("Annealled to " << Message_.PrettyString()
-                             << "\nwith squeeze factor" << Message_.SqueezeFactor);
+    MarkovMonitor.SqueezeStatistics(LastMessage.SqueezeFactor);
+    LOG_INFO("Annealled to " << LastMessage.PrettyString()
+                             << "\nwith squeeze factor" << LastMessage.SqueezeFactor);
+}
+
+/**
+*  Build a new chain on top of the parameters and the G/W weight of Master.
+*  The chain starts from a new diagram with an independent random number stream seeded by Master's RNG.
+*/
+bool EnvMonteCarlo::BuildChain(EnvMonteCarlo& Master)
+{
+    Para = Master.Para;
+    Para.Counter = 0;
+    Para.RNG.Reset(Master.Para.RNG.irn(0, INT_MAX - 1));
+    Weight.ShareGW(Master.Weight);
+    Weight.BuildNew(weight::SigmaPolar, Para);
+    Diag.BuildNew(Para.Lat, *Weight.G, *Weight.W);
+    Markov.BuildNew(Para, Diag, Weight);
+    MarkovMonitor.BuildNew(Para, Diag, Weight);
+    return true;
+}
+
+/**
+*  Build a replica at BetaRatio times the Beta of Master. G/W are copied from Master and read on
+*  the Tau grid of the new Beta, the same way annealing reads the G/W of the old Beta.
+*/
+bool EnvMonteCarlo::BuildReplica(EnvMonteCarlo& Master, real BetaRatio)
+{
+    Para = Master.Para;
+    Para.Counter = 0;
+    Para.RNG.Reset(Master.Para.RNG.irn(0, INT_MAX - 1));
+    _CopyGW(Master, BetaRatio);
+    Weight.BuildNew(weight::SigmaPolar, Para);
+    Diag.BuildNew(Para.Lat, *Weight.G, *Weight.W);
+    Markov.BuildNew(Para, Diag, Weight);
+    MarkovMonitor.BuildNew(Para, Diag, Weight);
     return true;
 }
+
+void EnvMonteCarlo::AnnealReplica(EnvMonteCarlo& Master, real BetaRatio)
+{
+    Para.UpdateWithMessage(Master.LastMessage);
+    _CopyGW(Master, BetaRatio);
+    _Anneal(Master.LastMessage);
+}
+
+void EnvMonteCarlo::_CopyGW(EnvMonteCarlo& Master, real BetaRatio)
+{
+    Para.Beta = Master.Para.Beta * BetaRatio;
+    Para.T = 1.0 / Para.Beta;
+    Weight.FromDict(Master.Weight.ToDict(weight::GW), weight::GW, Para);
+}
+
+/**
+*  Follow Master after it has been annealed, Master's G/W may have been reallocated
+*/
+void EnvMonteCarlo::AnnealChain(EnvMonteCarlo& Master)
+{
+    Para.UpdateWithMessage(Master.LastMessage);
+    Weight.ShareGW(Master.Weight);
+    _Anneal(Master.LastMessage);
+}
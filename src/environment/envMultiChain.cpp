@@ -0,0 +1,326 @@
+//
+//  envMultiChain.cpp
+//  Feynman_Simulator
+//
+
+#include "environment.h"
+#include "module/weight/component.h"
+#include "utility/utility.h"
+#include "utility/dictionary.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+using namespace para;
+
+//number of Steps all chains hop between two synchronizations, where the replicas are exchanged
+//and the statistics are added, the same number of Steps as a single chain between two AddStatistics
+const int StepsPerBlock = 100;
+
+/**
+*  Every chain thread waits in Wait() until all of them have arrived
+*/
+class ChainBarrier {
+public:
+    ChainBarrier(int n)
+        : _N(n)
+        , _Arrived(0)
+        , _Round(0)
+    {
+    }
+    void Wait()
+    {
+        unique_lock<mutex> lock(_Mutex);
+        int round = _Round;
+        if (++_Arrived == _N) {
+            _Arrived = 0;
+            _Round++;
+            _AllArrived.notify_all();
+        }
+        else
+            _AllArrived.wait(lock, [this, round]() { return _Round != round; });
+    }
+
+private:
+    mutex _Mutex;
+    condition_variable _AllArrived;
+    int _N, _Arrived, _Round;
+};
+
+EnvMultiChain::EnvMultiChain(const para::Job& job)
+    : Job(job)
+{
+    if (IsTempering()) {
+        ASSERT_ALLWAYS(Equal(Job.BetaLadder[0], 1.0), "BetaLadder should start from 1.0, the replica to measure!");
+        Job.Chains = Job.BetaLadder.size();
+    }
+    ASSERT_ALLWAYS(Job.Chains >= 1, "Number of chains should be positive!");
+    for (int i = 0; i < Job.Chains; i++)
+        Chains.push_back(new EnvMonteCarlo(job));
+    _ExchangeAccepted.assign(Job.Chains, 0.0);
+    _ExchangeProposed.assign(Job.Chains, 0.0);
+    _ExchangeRound = 0;
+}
+
+EnvMultiChain::~EnvMultiChain()
+{
+    //shared G/W are owned by Chains[0], so release it at last
+    for (int i = Chains.size() - 1; i >= 0; i--)
+        delete Chains[i];
+}
+
+EnvMonteCarlo& EnvMultiChain::Master()
+{
+    return *Chains[0];
+}
+
+bool EnvMultiChain::IsTempering()
+{
+    return !Job.BetaLadder.empty();
+}
+
+bool EnvMultiChain::BuildNew()
+{
+    Master().BuildNew();
+    for (int i = 1; i < int(Chains.size()); i++)
+        if (IsTempering())
+            Chains[i]->BuildReplica(Master(), Job.BetaLadder[i]);
+        else
+            Chains[i]->BuildChain(Master());
+    return true;
+}
+
+/**
+*  The Sigma/Polar and monitor statistics of all chains are saved with Chains[0]; every other chain
+*  continues from its own saved diagram, or from a new one if there is none
+*/
+bool EnvMultiChain::Load()
+{
+    Master().Load();
+    for (int i = 1; i < int(Chains.size()); i++) {
+        auto& chain = *Chains[i];
+        if (IsTempering())
+            chain.BuildReplica(Master(), Job.BetaLadder[i]);
+        else
+            chain.BuildChain(Master());
+        Dictionary config_;
+        try {
+            config_.Load(_ConfigFile(i));
+        }
+        catch (IOInvalid&) {
+            LOG_WARNING("Load " << _ConfigFile(i) << " failed, chain " << i << " starts from a new diagram!");
+            continue;
+        }
+        if (!chain.Diag.FromDict(config_))
+            chain.Diag.BuildNew(chain.Para.Lat, *chain.Weight.G, *chain.Weight.W);
+    }
+    return true;
+}
+
+void EnvMultiChain::Save()
+{
+    _ReduceStatistics();
+    Master().Save();
+    for (int i = 1; i < int(Chains.size()); i++)
+        Chains[i]->Diag.ToDict().Save(_ConfigFile(i), "w");
+}
+
+/**
+*  Every chain hops Steps*Sweep times on its own thread.
+*  The chains are synchronized every StepsPerBlock steps, where Chains[0] exchanges the replicas and
+*  adds the statistics of all chains, while the other chains wait.
+*/
+void EnvMultiChain::Hop(int Steps, bool DoesMeasure)
+{
+    ChainBarrier Barrier(Chains.size());
+    vector<thread> Threads;
+    for (int i = 0; i < int(Chains.size()); i++) {
+        auto chain = Chains[i];
+        //replicas at other Beta only help Chains[0] to decorrelate
+        bool measure = DoesMeasure && (i == 0 || !IsTempering());
+        Threads.push_back(thread([this, i, chain, Steps, DoesMeasure, measure, &Barrier]() {
+            for (int Done = 0; Done < Steps; Done += StepsPerBlock) {
+                int steps = min(StepsPerBlock, Steps - Done);
+                for (int Step = 0; Step < steps; Step++) {
+                    chain->Markov.Hop(chain->Para.Sweep);
+                    if (measure)
+                        chain->MarkovMonitor.Measure();
+                }
+                Barrier.Wait();
+                if (i == 0)
+                    _Synchronize(DoesMeasure);
+                Barrier.Wait();
+            }
+        }));
+    }
+    for (auto& t : Threads)
+        t.join();
+}
+
+bool EnvMultiChain::CheckDiagram()
+{
+    bool flag = true;
+    for (auto chain : Chains)
+        flag &= chain->Diag.CheckDiagram();
+    return flag;
+}
+
+void EnvMultiChain::TuneUpdateWeight()
+{
+    for (auto chain : Chains)
+        chain->Markov.TuneUpdateWeight();
+}
+
+/**
+*  The monitor of Chains[0] holds the statistics of all chains, the other chains take over its reweighting
+*/
+void EnvMultiChain::AdjustOrderReWeight()
+{
+    Master().AdjustOrderReWeight();
+    if (IsTempering())
+        return;
+    for (int i = 1; i < int(Chains.size()); i++) {
+        auto& chain = *Chains[i];
+        chain.Para.OrderReWeight = Master().Para.OrderReWeight;
+        chain.Para.WormSpaceReweight = Master().Para.WormSpaceReweight;
+        chain.Para.PolarReweight = Master().Para.PolarReweight;
+        chain.Markov.ClearCost();
+        chain.Markov.Reset(chain.Para, chain.Diag, chain.Weight);
+    }
+}
+
+bool EnvMultiChain::ListenToMessage()
+{
+    //so that the squeeze factor is applied once to the statistics of all chains
+    _ReduceStatistics();
+    if (!Master().ListenToMessage())
+        return false;
+    for (int i = 1; i < int(Chains.size()); i++)
+        if (IsTempering())
+            Chains[i]->AnnealReplica(Master(), Job.BetaLadder[i]);
+        else
+            Chains[i]->AnnealChain(Master());
+    //annealing squeezes the statistics of every chain, but only those of Chains[0] are kept
+    for (int i = 1; i < int(Chains.size()); i++)
+        Chains[i]->MarkovMonitor.ClearStatistics();
+    return true;
+}
+
+void EnvMultiChain::PrintExchangeInfo()
+{
+    if (!IsTempering())
+        return;
+    string Output = "Exchange between replicas:\n";
+    char temp[80];
+    for (int i = 0; i < int(Chains.size()) - 1; i++) {
+        sprintf(temp, "\tBeta %8.4f <-> %8.4f:%15g%15g%15g\n", Chains[i]->Para.Beta, Chains[i + 1]->Para.Beta,
+                _ExchangeProposed[i], _ExchangeAccepted[i],
+                _ExchangeProposed[i] > 0.0 ? _ExchangeAccepted[i] / _ExchangeProposed[i] : 0.0);
+        Output += temp;
+    }
+    LOG_INFO(Output);
+}
+
+/**
+*  Sigma/Polar accumulations are additive, move them from all chains into Chains[0]
+*/
+void EnvMultiChain::_ReduceStatistics()
+{
+    //replicas at other Beta do not measure
+    if (IsTempering())
+        return;
+    auto& Weight = Master().Weight;
+    for (int i = 1; i < int(Chains.size()); i++) {
+        auto& weight = Chains[i]->Weight;
+        Weight.Sigma->Estimator.MergeStatistics(weight.Sigma->Estimator);
+        weight.Sigma->Estimator.ClearStatistics();
+        Weight.Polar->Estimator.MergeStatistics(weight.Polar->Estimator);
+        weight.Polar->Estimator.ClearStatistics();
+    }
+}
+
+/**
+*  Called by the thread of Chains[0] between two blocks of Hop, while all other chains wait
+*/
+void EnvMultiChain::_Synchronize(bool DoesMeasure)
+{
+    if (IsTempering())
+        _Exchange();
+    if (!DoesMeasure)
+        return;
+    //the monitors are additive, move the measurements of all chains into Chains[0]
+    auto& Monitor = Master().MarkovMonitor;
+    if (!IsTempering())
+        for (int i = 1; i < int(Chains.size()); i++) {
+            Monitor.MergeStatistics(Chains[i]->MarkovMonitor);
+            Chains[i]->MarkovMonitor.ClearStatistics();
+        }
+    Monitor.AddStatistics();
+}
+
+string EnvMultiChain::_ConfigFile(int i)
+{
+    return Job.ParaFile + "_chain" + ToString(i);
+}
+
+/**
+*  Alternate between the even and the odd pairs of neighbouring replicas, so that every pair is
+*  tried every other round
+*/
+void EnvMultiChain::_Exchange()
+{
+    for (int i = _ExchangeRound % 2; i < int(Chains.size()) - 1; i += 2)
+        _TryExchange(i);
+    _ExchangeRound++;
+}
+
+/**
+*  Weight of a physical diagram with the G/W weight DiagWeight in the distribution sampled by a Markov chain with parameters Para
+*/
+inline real ChainWeight(const Amplitude& DiagWeight, const diag::Diagram& Diag, const ParaMC& Para)
+{
+    real weight = mod(DiagWeight) * Para.OrderReWeight[Diag.Order];
+    if (!Diag.MeasureGLine)
+        weight *= 0.5 * Para.PolarReweight;
+    return weight;
+}
+
+/**
+*  Exchange the diagrams of Chains[i] at Beta_a and Chains[i+1] at Beta_b. The diagram of a is
+*  moved to Beta_b by scaling all its n_a free Tau with Beta_b/Beta_a, and vice versa, so the
+*  exchange is accepted with
+*  W_b(D_a')W_a(D_b')/(W_a(D_a)W_b(D_b))*(Beta_b/Beta_a)^(n_a-n_b),
+*  the last factor being the Jacobian of the scaling.
+*  Only diagrams without worm at order>=1 are exchanged, where the Tau of all vertices are free.
+*  The diagrams are only copied, through snapshots, once the exchange is accepted.
+*/
+void EnvMultiChain::_TryExchange(int i)
+{
+    EnvMonteCarlo &a = *Chains[i], &b = *Chains[i + 1];
+    if (a.Diag.Worm.Exist || b.Diag.Worm.Exist || a.Diag.Order == 0 || b.Diag.Order == 0)
+        return;
+    _ExchangeProposed[i] += 1.0;
+
+    real oldWeight = ChainWeight(a.Diag.Weight, a.Diag, a.Para) * ChainWeight(b.Diag.Weight, b.Diag, b.Para);
+    real ratio = b.Para.Beta / a.Para.Beta;
+    int nTauA = a.Diag.NumOfFreeTau(), nTauB = b.Diag.NumOfFreeTau();
+
+    //evaluate each diagram with the G/W of the other replica
+    real newWeight = ChainWeight(a.Diag.RescaledWeight(ratio, *b.Weight.G, *b.Weight.W), a.Diag, b.Para)
+                     * ChainWeight(b.Diag.RescaledWeight(1.0 / ratio, *a.Weight.G, *a.Weight.W), b.Diag, a.Para);
+
+    real prob = newWeight / oldWeight * pow(ratio, nTauA - nTauB);
+    if (prob < 1.0 && Master().Para.RNG.urn() >= prob)
+        return;
+    _ExchangeAccepted[i] += 1.0;
+    diag::DiagramSnapshot snapA, snapB;
+    a.Diag.ToSnapshot(snapA);
+    b.Diag.ToSnapshot(snapB);
+    for (int v = 0; v < snapA.NVer; v++)
+        snapA.VerTau[v] *= ratio;
+    for (int v = 0; v < snapB.NVer; v++)
+        snapB.VerTau[v] /= ratio;
+    a.Diag.FromSnapshot(snapB);
+    b.Diag.FromSnapshot(snapA);
+}
@@ -9,12 +9,14 @@
 #ifndef __Feynman_Simulator__environment__
 #define __Feynman_Simulator__environment__
 
+#include <vector>
 #include "module/parameter/parameter.h"
 #include "module/diagram/diagram.h"
 #include "module/weight/weight.h"
 #include "module/markov/markov_monitor.h"
 #include "module/markov/markov.h"
 #include "job/job.h"
+#include "config_pool.h"
 
 class EnvMonteCarlo {
 public:
@@ -27,6 +29,7 @@ public:
     diag::Diagram Diag;
     mc::Markov Markov;
     mc::MarkovMonitor MarkovMonitor;
+    para::Message LastMessage;
 
     bool BuildNew();
     bool Load();
@@ -36,8 +39,65 @@ public:
 
     bool ListenToMessage();
 
+    //start from a thermalized diagram in Job.ConfigPool, return false if there is no usable one
+    bool WarmStart();
+    void DepositConfig();
+
+    //a chain which shares the G/W weight of Master, but has its own diagram, RNG and Sigma/Polar
+    bool BuildChain(EnvMonteCarlo& Master);
+    void AnnealChain(EnvMonteCarlo& Master);
+    //a parallel tempering replica at BetaRatio*Beta of Master, with its own copy of G/W
+    bool BuildReplica(EnvMonteCarlo& Master, real BetaRatio);
+    void AnnealReplica(EnvMonteCarlo& Master, real BetaRatio);
+
 private:
     std::string _DiagramFile;
+    ConfigPool _Pool;
+    void _Anneal(const para::Message&);
+    void _CopyGW(EnvMonteCarlo& Master, real BetaRatio);
+};
+
+/**
+*  Run several independent Markov chains in one process, one thread per chain.
+*  Chains[0] loads and owns G/W, all the other chains only read them.
+*  The monitor statistics of all chains are merged into Chains[0] every StepsPerBlock steps, and
+*  Sigma/Polar statistics before they are saved.
+*
+*  With a non-empty Job.BetaLadder the chains are parallel tempering replicas instead: Chains[i]
+*  runs at Job.BetaLadder[i]*Beta with its own G/W, only Chains[0] measures, and the diagrams of
+*  neighbouring replicas are exchanged every StepsPerBlock steps.
+*/
+class EnvMultiChain {
+public:
+    EnvMultiChain(const para::Job& job);
+    ~EnvMultiChain();
+
+    para::Job Job;
+    std::vector<EnvMonteCarlo*> Chains;
+    EnvMonteCarlo& Master();
+
+    bool BuildNew();
+    bool Load();
+    void Save();
+    void Hop(int Steps, bool DoesMeasure);
+    bool CheckDiagram();
+    void TuneUpdateWeight();
+    void AdjustOrderReWeight();
+    bool ListenToMessage();
+    bool IsTempering();
+    void PrintExchangeInfo();
+
+private:
+    //exchange between Chains[i] and Chains[i+1]
+    std::vector<real> _ExchangeAccepted;
+    std::vector<real> _ExchangeProposed;
+    int _ExchangeRound;
+    void _ReduceStatistics();
+    void _Synchronize(bool DoesMeasure);
+    //the diagram of Chains[i], saved next to the para file of Chains[0]
+    std::string _ConfigFile(int i);
+    void _Exchange();
+    void _TryExchange(int i);
 };
 
 int TestEnvironment();
@@ -96,6 +96,17 @@ void Estimator<T>::ClearStatistics()
     //small enough non-zero number to avoid NAN
 }
 
+/**
+*  Both estimators start with a norm of 1.0, the one of the other estimator is not added, so that it can
+*  be merged again and again after it is cleared
+*/
+template <typename T>
+void Estimator<T>::MergeStatistics(const Estimator<T>& source)
+{
+    _accumulator += source._accumulator;
+    _norm += source._norm - 1.0;
+}
+
 template <typename T>
 void Estimator<T>::SqueezeStatistics(real factor)
 {
@@ -348,5 +359,13 @@ void EstimatorBundle<T>::SqueezeStatistics(double factor)
         vector.SqueezeStatistics(factor);
 }
 
+template <typename T>
+void EstimatorBundle<T>::MergeStatistics(const EstimatorBundle<T>& source)
+{
+    ASSERT_ALLWAYS(_EstimatorVector.size() == source._EstimatorVector.size(), "Shape should match!");
+    for (uint i = 0; i < _EstimatorVector.size(); i++)
+        _EstimatorVector[i].MergeStatistics(source._EstimatorVector[i]);
+}
+
 template class EstimatorBundle<Complex>;
 template class EstimatorBundle<real>;
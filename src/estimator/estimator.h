@@ -62,6 +62,8 @@ public:
     Dictionary ToDict();
     void ClearStatistics();
     void SqueezeStatistics(real factor);
+    //add the measurements of another estimator, which should be cleared before it is merged again; its history is not merged
+    void MergeStatistics(const Estimator&);
 };
 
 /**
@@ -89,6 +91,7 @@ public:
     EstimatorT& operator[](std::string);
     void ClearStatistics();
     void SqueezeStatistics(real factor);
+    void MergeStatistics(const EstimatorBundle&);
 };
 
 int TestEstimator();
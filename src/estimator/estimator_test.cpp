@@ -81,4 +81,19 @@ void TestObservableReal()
                      "check the Mean value.");
     sput_fail_unless(Equal(quan1.Estimate().Error, ExpectedResult.Error, 1e-6),
                      "check the Error value.");
+
+    //two chains measure every other value, the second one is merged into the first one before every AddStatistics
+    Estimator<real> chain1("1"), chain2("1");
+    for (int i = 0; i < 10; i++) {
+        (i % 2 == 0 ? chain1 : chain2).Measure(a[i]);
+        chain1.MergeStatistics(chain2);
+        chain2.ClearStatistics();
+        chain1.AddStatistics();
+    }
+    sput_fail_unless(Equal(chain1.Norm(), quan1.Norm(), 1e-6),
+                     "Merge:check the norm.");
+    sput_fail_unless(Equal(chain1.Estimate().Mean, ExpectedResult.Mean, 1e-6),
+                     "Merge:check the Mean value.");
+    sput_fail_unless(Equal(chain1.Estimate().Error, ExpectedResult.Error, 1e-6),
+                     "Merge:check the Error value.");
 }
\ No newline at end of file
@@ -26,6 +26,11 @@ para::Job::Job(string inputfile)
     GET(_Para, Sample);
     GET(_Para, PID);
     GET(_Para, Sample);
+    GET_WITH_DEFAULT(_Para, Chains, 1);
+    GET_WITH_DEFAULT(_Para, BetaLadder, std::vector<real>());
+    GET_WITH_DEFAULT(_Para, AsyncMeasure, false);
+    GET_WITH_DEFAULT(_Para, PipelineCPUs, std::vector<int>());
+    GET_WITH_DEFAULT(_Para, ConfigPool, std::string());
     GET(_Para, WeightFile);
     GET(_Para, MessageFile);
     string Prefix = ToString(PID) + "_" + string(Type);
@@ -12,6 +12,7 @@
 #include "utility/convention.h"
 #include <string>
 #include <set>
+#include <vector>
 
 namespace para {
 class Job {
@@ -26,6 +27,15 @@ public:
     bool DoesLoad;
     int Sample;
     int PID;
+    int Chains; //number of Markov chains (threads) in one process
+    //Beta of parallel tempering replicas relative to Beta, starting with 1.0; empty if no tempering
+    std::vector<real> BetaLadder;
+    //apply Sigma/Polar measurements on a second thread, only for a single chain
+    bool AsyncMeasure;
+    //cpus to pin the Markov thread and the measurement thread of AsyncMeasure on, empty to leave them to the kernel
+    std::vector<int> PipelineCPUs;
+    //directory of thermalized diagrams shared by jobs, empty to always thermalize from scratch
+    std::string ConfigPool;
     std::string WeightFile;
     std::string MessageFile;
     std::string StatisticsFile;
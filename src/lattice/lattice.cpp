@@ -25,6 +25,8 @@ void Lattice::Initialize(const Vec<int>& size, int NSublat)
         Vol *= Size[i];
     }
     SublatVol = NSublat;
+    NClass = 0;
+    _Class.clear();
 }
 
 bool operator==(const Site& v1, const Site& v2)
@@ -10,6 +10,8 @@
 #define __Fermion_Simulator__lattice__
 
 #include "utility/vector.h"
+#include <string>
+#include <vector>
 
 int GetSublatIndex(int, int);
 
@@ -49,6 +51,27 @@ public:
     Vec<int> Index2Vec(int) const;
     int CoordiIndex(const Site& in, const Site& out) const;
     void Shift(Vec<int>& vec) const;
+
+    //number of displacement classes under the point group, 0 if SetPointGroup is not called
+    int NClass;
+    //merge the site pairs related by the point group of the named lattice of dyson/lattice.py into classes
+    void SetPointGroup(const std::string& Name);
+    bool HasPointGroup() const
+    {
+        return NClass > 0;
+    }
+    int DisplacementClass(const Site& in, const Site& out) const
+    {
+        return _Class[(in.Sublattice * SublatVol + out.Sublattice) * Vol + CoordiIndex(in, out)];
+    }
+    int DisplacementClass(int SubIn, int SubOut, int Coordi) const
+    {
+        return _Class[(SubIn * SublatVol + SubOut) * Vol + Coordi];
+    }
+
+private:
+    //class of each (SubIn, SubOut, displacement)
+    std::vector<int> _Class;
 };
 
 int TestLattice();
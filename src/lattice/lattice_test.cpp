@@ -15,8 +15,10 @@ using std::cout;
 using std::endl;
 
 void Test_Lattice();
+void Test_PointGroup();
 
-int L[] = { 16, 32 };
+//only the first D sizes and components below are used
+int L[] = { 16, 32, 8 };
 Vec<int> size(L);
 
 Lattice lattice(size, 2);
@@ -26,22 +28,46 @@ int TestLattice()
     sput_start_testing();
     sput_enter_suite("Test Definition of Class Lattice");
     sput_run_test(Test_Lattice);
+    sput_run_test(Test_PointGroup);
     sput_finish_testing();
     return sput_get_return_value();
 }
 
 void Test_Lattice()
 {
-    Vec<int> v0{ 1, 2 };
-    sput_fail_unless(v0[0] == 1 && v0[1] == 2, "Vector:test initialization");
+    Vec<int> v0{ 1, 2, 3 };
+    sput_fail_unless(v0[0] == 1 && v0[D - 1] == D, "Vector:test initialization");
 
     Vec<int> v, v1, v2;
-    v = { 2, 1 };
-    v2 = { 8, 4 };
+    v = { 2, 1, 3 };
+    v2 = { 8, 4, 12 };
     sput_fail_unless((v * 3 + v) == v2, "Vector:test the operators for vectors");
     Site s1, s2;
-    s1.Coordinate = { 3, 1 };
+    s1.Coordinate = { 3, 1, 2 };
     s1.Sublattice = 1;
-    s2.Coordinate = { 4, 3 };
+    s2.Coordinate = { 4, 3, 5 };
     s2.Sublattice = 0;
 }
+
+void Test_PointGroup()
+{
+    int L8[] = { 8, 8, 8 };
+    Lattice lat(Vec<int>(L8), 1);
+    lat.SetPointGroup(D == 2 ? "Square" : "Cubic");
+    //displacements with 0<=x<=y(<=z)<=4
+    sput_fail_unless(lat.NClass == (D == 2 ? 15 : 35), "PointGroup: number of classes on square/cubic lattice");
+
+    Site origin(0, Vec<int>(0)), r1(0, Vec<int>(0)), r2(0, Vec<int>(0)), r3(0, Vec<int>(0));
+    r1.Coordinate[0] = 1;
+    r1.Coordinate[D - 1] = 2;
+    r2.Coordinate[0] = 6;
+    r2.Coordinate[D - 1] = 1;
+    r3.Coordinate[0] = 1;
+    r3.Coordinate[D - 1] = 3;
+    sput_fail_unless(lat.DisplacementClass(origin, r1) == lat.DisplacementClass(origin, r2),
+                     "PointGroup: rotated displacements share a class");
+    sput_fail_unless(lat.DisplacementClass(origin, r1) == lat.DisplacementClass(r1, origin),
+                     "PointGroup: inverted displacements share a class");
+    sput_fail_unless(lat.DisplacementClass(origin, r1) != lat.DisplacementClass(origin, r3),
+                     "PointGroup: displacements of different length are in different classes");
+}
@@ -0,0 +1,248 @@
+//
+//  point_group.cpp
+//  Feynman_Simulator
+//
+
+#include "lattice.h"
+#include "utility/abort.h"
+#include "utility/convention.h"
+#include <math.h>
+using namespace std;
+
+//lattice vectors (rows) and sublattice vectors of the lattices in dyson/lattice.py
+struct Geometry {
+    string Name;
+    int Dim;
+    int NSublat;
+    real LatVec[3][3];
+    real SubLatVec[4][3];
+};
+
+const real ROOT3 = sqrt(3.0);
+const Geometry GEOMETRIES[] = {
+    { "Checkerboard", 2, 2, { { 1.0, 1.0 }, { 1.0, -1.0 } }, { { 0.0, 0.0 }, { 1.0, 0.0 } } },
+    { "ValenceBond", 2, 2, { { 1.0, 0.0 }, { 0.0, 2.0 } }, { { 0.0, 0.0 }, { 0.0, 1.0 } } },
+    { "Square", 2, 1, { { 1.0, 0.0 }, { 0.0, 1.0 } }, { { 0.0, 0.0 } } },
+    { "Triangular", 2, 1, { { 1.0, 0.0 }, { 0.5, ROOT3 / 2.0 } }, { { 0.0, 0.0 } } },
+    { "Honeycomb", 2, 2, { { 0.0, 1.0 }, { ROOT3 / 2.0, -0.5 } }, { { 0.0, 0.0 }, { 0.5 / ROOT3, 0.5 } } },
+    { "Kagome", 2, 3, { { 1.0, 0.0 }, { 0.5, ROOT3 / 2.0 } },
+      { { 0.5, 0.0 }, { 0.25, ROOT3 / 4.0 }, { 0.75, ROOT3 / 4.0 } } },
+    { "Cubic", 3, 1, { { 1.0, 0.0, 0.0 }, { 0.0, 1.0, 0.0 }, { 0.0, 0.0, 1.0 } }, { { 0.0, 0.0, 0.0 } } },
+    { "3DCheckerboard", 3, 2, { { 1.0, 1.0, 0.0 }, { 1.0, -1.0, 0.0 }, { 1.0, 0.0, 1.0 } },
+      { { 0.0, 0.0, 0.0 }, { 1.0, 0.0, 0.0 } } },
+    { "Pyrochlore", 3, 4, { { 0.0, 0.5, 0.5 }, { 0.5, 0.0, 0.5 }, { 0.5, 0.5, 0.0 } },
+      { { 0.0, 0.0, 0.0 }, { 0.0, 0.25, 0.25 }, { 0.25, 0.0, 0.25 }, { 0.25, 0.25, 0.0 } } }
+};
+
+//entries of the integer matrices tried as point group operations in lattice coordinates
+const int MAX_ENTRY = 2;
+const real SYMMETRY_EPS = 1.0e-8;
+
+/**
+*  A point group operation x -> x*R + c in real space, written in lattice coordinates:
+*  the site (n, k) goes to (n*M + Shift[k], Sublat[k]).
+*/
+struct Operation {
+    int M[D][D];
+    int Sublat[4];
+    int Shift[4][D];
+};
+
+typedef real Matrix[D][D];
+
+void Multiply(const Matrix& a, const Matrix& b, Matrix& c)
+{
+    for (int i = 0; i < D; i++)
+        for (int j = 0; j < D; j++) {
+            c[i][j] = 0.0;
+            for (int k = 0; k < D; k++)
+                c[i][j] += a[i][k] * b[k][j];
+        }
+}
+
+void Inverse(const Matrix& a, Matrix& inv)
+{
+    Matrix m;
+    for (int i = 0; i < D; i++)
+        for (int j = 0; j < D; j++) {
+            m[i][j] = a[i][j];
+            inv[i][j] = (i == j);
+        }
+    for (int c = 0; c < D; c++) {
+        int pivot = c;
+        for (int r = c + 1; r < D; r++)
+            if (fabs(m[r][c]) > fabs(m[pivot][c]))
+                pivot = r;
+        ASSERT_ALLWAYS(fabs(m[pivot][c]) > SYMMETRY_EPS, "Lattice vectors are not independent!");
+        for (int j = 0; j < D; j++) {
+            swap(m[c][j], m[pivot][j]);
+            swap(inv[c][j], inv[pivot][j]);
+        }
+        real p = m[c][c];
+        for (int j = 0; j < D; j++) {
+            m[c][j] /= p;
+            inv[c][j] /= p;
+        }
+        for (int r = 0; r < D; r++) {
+            if (r == c)
+                continue;
+            real f = m[r][c];
+            for (int j = 0; j < D; j++) {
+                m[r][j] -= f * m[c][j];
+                inv[r][j] -= f * inv[c][j];
+            }
+        }
+    }
+}
+
+//lattice coordinates of a real space vector, if they are all integers
+bool ToLattice(const real* x, const Matrix& AInv, int* n)
+{
+    for (int j = 0; j < D; j++) {
+        real v = 0.0;
+        for (int i = 0; i < D; i++)
+            v += x[i] * AInv[i][j];
+        n[j] = int(floor(v + 0.5));
+        if (fabs(v - n[j]) > SYMMETRY_EPS)
+            return false;
+    }
+    return true;
+}
+
+//is x*R an orthogonal map, with R=A^-1*M*A
+bool IsOrthogonal(const int M[D][D], const Matrix& A, const Matrix& AInv, Matrix& R)
+{
+    Matrix MA, m;
+    for (int i = 0; i < D; i++)
+        for (int j = 0; j < D; j++)
+            m[i][j] = M[i][j];
+    Multiply(m, A, MA);
+    Multiply(AInv, MA, R);
+    for (int i = 0; i < D; i++)
+        for (int j = 0; j < D; j++) {
+            real dot = 0.0;
+            for (int k = 0; k < D; k++)
+                dot += R[i][k] * R[j][k];
+            if (fabs(dot - (i == j)) > SYMMETRY_EPS)
+                return false;
+        }
+    return true;
+}
+
+//find the sublattice and the shift of every sublattice under x -> x*R + c
+bool MapSublattices(const Geometry& geo, const Matrix& R, const real* c, const Matrix& AInv, Operation& op)
+{
+    for (int k = 0; k < geo.NSublat; k++) {
+        real y[D];
+        for (int j = 0; j < D; j++) {
+            y[j] = c[j];
+            for (int i = 0; i < D; i++)
+                y[j] += geo.SubLatVec[k][i] * R[i][j];
+        }
+        op.Sublat[k] = -1;
+        for (int target = 0; target < geo.NSublat && op.Sublat[k] < 0; target++) {
+            real diff[D];
+            for (int j = 0; j < D; j++)
+                diff[j] = y[j] - geo.SubLatVec[target][j];
+            if (ToLattice(diff, AInv, op.Shift[k]))
+                op.Sublat[k] = target;
+        }
+        if (op.Sublat[k] < 0)
+            return false;
+    }
+    return true;
+}
+
+int Find(vector<int>& parent, int i)
+{
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+/**
+*  Every integer matrix M (entries within MAX_ENTRY) which is an orthogonal map in real space and maps
+*  the periodic lattice onto itself is combined with the translations taking sublattice 0 onto each
+*  sublattice; the combinations mapping all sublattices onto sublattices form the point group.
+*  Site pairs (SubIn, SubOut, displacement) related by an operation are merged into one class.
+*/
+void Lattice::SetPointGroup(const string& Name)
+{
+    const Geometry* geo = nullptr;
+    for (auto& g : GEOMETRIES)
+        if (g.Name == Name)
+            geo = &g;
+    ASSERT_ALLWAYS(geo != nullptr, "Lattice " << Name << " has no point group yet!");
+    ASSERT_ALLWAYS(geo->Dim == D && geo->NSublat == SublatVol,
+                   "Lattice " << Name << " is " << geo->Dim << "D with " << geo->NSublat << " sublattices!");
+
+    Matrix A, AInv;
+    for (int i = 0; i < D; i++)
+        for (int j = 0; j < D; j++)
+            A[i][j] = geo->LatVec[i][j];
+    Inverse(A, AInv);
+
+    vector<Operation> Group;
+    Operation op;
+    int NMatrix = 1;
+    for (int i = 0; i < D * D; i++)
+        NMatrix *= 2 * MAX_ENTRY + 1;
+    for (int code = 0; code < NMatrix; code++) {
+        int rest = code;
+        for (int i = 0; i < D; i++)
+            for (int j = 0; j < D; j++) {
+                op.M[i][j] = rest % (2 * MAX_ENTRY + 1) - MAX_ENTRY;
+                rest /= 2 * MAX_ENTRY + 1;
+            }
+        bool periodic = true;
+        for (int i = 0; i < D; i++)
+            for (int j = 0; j < D; j++)
+                periodic = periodic && (Size[i] * op.M[i][j]) % Size[j] == 0;
+        Matrix R;
+        if (!periodic || !IsOrthogonal(op.M, A, AInv, R))
+            continue;
+        for (int target = 0; target < SublatVol; target++) {
+            real c[D];
+            for (int j = 0; j < D; j++) {
+                c[j] = geo->SubLatVec[target][j];
+                for (int i = 0; i < D; i++)
+                    c[j] -= geo->SubLatVec[0][i] * R[i][j];
+            }
+            if (MapSublattices(*geo, R, c, AInv, op))
+                Group.push_back(op);
+        }
+    }
+
+    vector<int> parent(SublatVol * SublatVol * Vol);
+    for (uint e = 0; e < parent.size(); e++)
+        parent[e] = e;
+    for (auto& g : Group)
+        for (int in = 0; in < SublatVol; in++)
+            for (int out = 0; out < SublatVol; out++)
+                for (int coord = 0; coord < Vol; coord++) {
+                    Vec<int> r = Index2Vec(coord), image;
+                    for (int j = 0; j < D; j++) {
+                        image[j] = g.Shift[out][j] - g.Shift[in][j];
+                        for (int i = 0; i < D; i++)
+                            image[j] += r[i] * g.M[i][j];
+                        image[j] = ((image[j] % Size[j]) + Size[j]) % Size[j];
+                    }
+                    int a = Find(parent, (in * SublatVol + out) * Vol + coord);
+                    int b = Find(parent, (g.Sublat[in] * SublatVol + g.Sublat[out]) * Vol + Vec2Index(image));
+                    parent[a] = b;
+                }
+
+    _Class.assign(parent.size(), -1);
+    vector<int> label(parent.size(), -1);
+    NClass = 0;
+    for (uint e = 0; e < parent.size(); e++) {
+        int root = Find(parent, e);
+        if (label[root] < 0)
+            label[root] = NClass++;
+        _Class[e] = label[root];
+    }
+    LOG_INFO("Point group of " << Name << " has " << Group.size() << " operations, "
+                               << parent.size() << " site pairs are merged into " << NClass << " classes");
+}
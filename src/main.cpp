@@ -9,24 +9,47 @@
 /********************** include files *****************************************/
 #include <iostream>
 #include <unistd.h>
+#include <dirent.h>
 #include "test.h"
 #include "environment/environment.h"
 #include "utility/pyglue/pywrapper.h"
 #include "job/job.h"
 #include "utility/timer.h"
+#include "module/markov/markov.h"
+#include "utility/dictionary.h"
 
 using namespace std;
 using namespace para;
 
 const string HelpStr = "Usage:"
                        "-p N / --PID N   use N to construct input file path."
-                       "or -f / --file PATH   use PATH as the input file path.";
+                       "or -f / --file PATH   use PATH as the input file path."
+                       "or -b / --benchmark [N]   call each Markov update N times in test configurations."
+                       "or -a / --accuracy [N]   compare N steps with single and double precision G/W tables.";
 void MonteCarlo(const Job&);
+void MultiChainMonteCarlo(const Job&);
+void SwitchEngine(const string& InputFile, const char* argv[]);
+//set by SwitchEngine in the environment of the engine it starts
+const char* HANDOVER = "FEYNMAN_SIMULATOR_HANDOVER";
 int main(int argc, const char* argv[])
 {
     Python::Initialize();
     Python::ArrayInitialize();
-    RunTest();
+    //the benchmarks run on the test configurations, without running the tests first
+    bool IsBenchmark = argc >= 2 && (strcmp(argv[1], "-b") == 0 || strcmp(argv[1], "--benchmark") == 0);
+    bool IsAccuracy = argc >= 2 && (strcmp(argv[1], "-a") == 0 || strcmp(argv[1], "--accuracy") == 0);
+    if (IsBenchmark || IsAccuracy) {
+        LOGGER_CONF("benchmark.log", "benchmark", Logger::file_on | Logger::screen_on, INFO, INFO);
+        if (IsBenchmark)
+            mc::BenchmarkMarkov(argc == 3 ? atoll(argv[2]) : 1000000);
+        else
+            mc::ValidatePrecision(argc == 3 ? atoll(argv[2]) : 100000);
+        Python::Finalize();
+        return 0;
+    }
+    //the tests have been run by the executable which handed the job over
+    if (getenv(HANDOVER) == nullptr)
+        RunTest();
     ASSERT_ALLWAYS(argc == 3, HelpStr);
     string InputFile;
     if (strcmp(argv[1], "-p") == 0 || strcmp(argv[1], "--PID") == 0)
@@ -35,10 +58,13 @@ int main(int argc, const char* argv[])
         InputFile = argv[2];
     else
         ABORT("Unable to parse arguments!\n" + HelpStr);
+    SwitchEngine(InputFile, argv);
 
     para::Job Job(InputFile);
 
-    if (Job.Type == "MC")
+    if (Job.Type == "MC" && (Job.Chains > 1 || !Job.BetaLadder.empty()))
+        MultiChainMonteCarlo(Job);
+    else if (Job.Type == "MC")
         MonteCarlo(Job);
     else
         cout << "Not Defined" << endl;
@@ -46,6 +72,46 @@ int main(int argc, const char* argv[])
     return 0;
 }
 
+/**
+*  Hand the job over to the engine built for its dimension and order, if this one does not fit it.
+*  Engines are simulator_D<dimension>_O<max order>.exe next to this executable, see ENGINES in CMakeLists.txt;
+*  the one with the smallest order cap is picked.
+*/
+void SwitchEngine(const string& InputFile, const char* argv[])
+{
+    Dictionary Input;
+    Input.Load(InputFile);
+    auto Para = Input.Get<Dictionary>("Para");
+    int dimension = Para.Get<Dictionary>("Lattice").Get<vector<int> >("L").size();
+    int order = Para.Get<Dictionary>("Markov").Get<int>("Order");
+    if (dimension == D && order < MAX_ORDER)
+        return;
+
+    string exe = argv[0];
+    string dir = exe.find('/') == string::npos ? "." : exe.substr(0, exe.rfind('/'));
+    string engine;
+    int cap = 0;
+    DIR* folder = opendir(dir.c_str());
+    while (folder != nullptr) {
+        dirent* entry = readdir(folder);
+        if (entry == nullptr)
+            break;
+        int d, o;
+        if (sscanf(entry->d_name, "simulator_D%d_O%d.exe", &d, &o) == 2 && d == dimension && o > order && (cap == 0 || o < cap)) {
+            cap = o;
+            engine = dir + "/" + entry->d_name;
+        }
+    }
+    if (folder != nullptr)
+        closedir(folder);
+    ASSERT_ALLWAYS(!engine.empty(), "No engine is built for D=" << dimension << " and Order=" << order
+                                                                << ", add it to ENGINES in CMakeLists.txt!");
+    LOG_INFO("Hand the job over to " << engine);
+    setenv(HANDOVER, "1", 1);
+    execv(engine.c_str(), (char* const*)argv);
+    ABORT("Fail to start " << engine);
+}
+
 void MonteCarlo(const para::Job& Job)
 {
     InterruptHandler Interrupt;
@@ -71,10 +137,18 @@ void MonteCarlo(const para::Job& Job)
 
     Env.ListenToMessage();
 
-    for (uint Step = 0; Step < Para.Toss; Step++) {
+    //a new job starting from a thermalized snapshot skips the thermalization
+    bool IsWarm = !Job.DoesLoad && Env.WarmStart();
+    for (int Step = 0; !IsWarm && Step < Para.Toss; Step++) {
         Markov.Hop(Para.Sweep);
+        //tune with the statistics of the first half, thermalize with the frozen table in the second half
+        if (Step == Para.Toss / 2)
+            Markov.TuneUpdateWeight();
     }
 
+    if (Job.AsyncMeasure)
+        MarkovMonitor.StartPipeline(Job.PipelineCPUs);
+
     //    for (uint i = 0; i < 1000; i++) {
     //        for (uint Step = 0; Step < Job.Sample; Step++) {
     uint Step = 0;
@@ -104,6 +178,7 @@ void MonteCarlo(const para::Job& Job)
             if (DiskWriterTimer.check(Para.DiskWriterTimer)) {
                 Interrupt.Delay();
                 Env.Save();
+                Env.DepositConfig();
                 Interrupt.Resume();
             }
 
@@ -116,3 +191,55 @@ void MonteCarlo(const para::Job& Job)
     }
     LOG_INFO("Markov is ended!");
 }
+
+//number of Steps every chain hops between two checks of the timers, the statistics are added within Hop
+const int ChainBlock = 1000;
+
+void MultiChainMonteCarlo(const para::Job& Job)
+{
+    InterruptHandler Interrupt;
+    EnvMultiChain Env(Job);
+    if (Job.DoesLoad)
+        Env.Load();
+    else
+        Env.BuildNew();
+
+    auto& Master = Env.Master();
+    auto& Para = Master.Para;
+
+    LOG_INFO("Markov is started with " << Env.Chains.size() << (Env.IsTempering() ? " replicas!" : " chains!"));
+    timer ReweightTimer, PrinterTimer, DiskWriterTimer, MessageTimer;
+    PrinterTimer.start();
+    DiskWriterTimer.start();
+    MessageTimer.start();
+    ReweightTimer.start();
+
+    Env.ListenToMessage();
+
+    Env.Hop(Para.Toss / 2, false);
+    Env.TuneUpdateWeight();
+    Env.Hop(Para.Toss - Para.Toss / 2, false);
+
+    while (true) {
+        Env.Hop(ChainBlock, true);
+
+        if (PrinterTimer.check(Para.PrinterTimer)) {
+            Env.CheckDiagram();
+            Master.Markov.PrintDetailBalanceInfo();
+            Env.PrintExchangeInfo();
+        }
+
+        if (DiskWriterTimer.check(Para.DiskWriterTimer)) {
+            Interrupt.Delay();
+            Env.Save();
+            Interrupt.Resume();
+        }
+
+        if (MessageTimer.check(Para.MessageTimer))
+            Env.ListenToMessage();
+
+        if (ReweightTimer.check(Para.ReweightTimer))
+            Env.AdjustOrderReWeight();
+    }
+    LOG_INFO("Markov is ended!");
+}
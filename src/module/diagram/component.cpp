@@ -45,7 +45,7 @@ vertex GLine::NeighVer(int dir)
     return nVer[dir];
 }
 
-void GLine::SetGLine(Momentum k, const Complex &weight, bool ismeasure)
+void GLine::SetGLine(Momentum k, const Amplitude &weight, bool ismeasure)
 {
     K = k;
     Weight = weight;
@@ -77,7 +77,7 @@ vertex WLine::NeighVer(int dir)
     return nVer[dir];
 }
 
-void WLine::SetWLine(Momentum k, const Complex &weight, bool isworm, bool ismeasure, bool isdelta)
+void WLine::SetWLine(Momentum k, const Amplitude &weight, bool isworm, bool ismeasure, bool isdelta)
 {
     K = k;
     Weight = weight;
@@ -32,7 +32,7 @@ class GLine {
     bool IsMeasure;
     vertex nVer[2];
     Momentum K;
-    Complex Weight;
+    Amplitude Weight;
 
     spin Spin();
     spin Spin(int dir);
@@ -40,7 +40,7 @@ class GLine {
     int Sublattice(int dir);
     vertex NeighVer(int dir);
     std::string PrettyString();
-    void SetGLine(Momentum, const Complex &, bool);
+    void SetGLine(Momentum, const Amplitude &, bool);
 };
 
 class WLine {
@@ -51,14 +51,14 @@ class WLine {
     bool IsMeasure;
     vertex nVer[2];
     Momentum K;
-    Complex Weight;
+    Amplitude Weight;
 
     spin Spin(int, int);
     void FlipSpin();
     int Sublattice(int dir);
     vertex NeighVer(int dir);
     std::string PrettyString();
-    void SetWLine(Momentum, const Complex &, bool, bool, bool);
+    void SetWLine(Momentum, const Amplitude &, bool, bool, bool);
 };
 
 class Vertex {
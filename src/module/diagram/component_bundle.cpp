@@ -21,6 +21,7 @@ Bundle<T>::Bundle(string bundle_name)
         _component_name[i] = _component_bundle + i;
     }
     _available_space = 0;
+    _journaling = false;
 }
 
 template <typename T>
@@ -41,6 +42,8 @@ T *Bundle<T>::Add()
     //////////
 
     _available_space++;
+    if (_journaling)
+        _journal.push_back(-1);
     return address;
 }
 
@@ -49,6 +52,8 @@ void Bundle<T>::Add(T *Target)
 {
     if (_available_space >= MAX_BUNDLE)
         ABORT("Too many objects >=" << MAX_BUNDLE);
+    if (DEBUGMODE && _journaling)
+        ABORT("Adding a copy of component can not be rolled back!");
     _component_name[_available_space] = Target;
     _available_space++;
 }
@@ -68,6 +73,8 @@ void Bundle<T>::Remove(name name)
 
     _component_name[name] = last;
     _component_name[_available_space] = target;
+    if (_journaling)
+        _journal.push_back(name);
     return;
 }
 
@@ -90,6 +97,8 @@ void Bundle<T>::Remove(T *target)
 
     _component_name[name] = last;
     _component_name[_available_space] = target;
+    if (_journaling)
+        _journal.push_back(name);
     return;
 }
 
@@ -122,6 +131,41 @@ void Bundle<T>::Recover(int step)
     //TODO: please take a careful thought on Recover, does the component has the correct name?
 }
 
+template <typename T>
+void Bundle<T>::StartJournal()
+{
+    _journal.clear();
+    _journaling = true;
+}
+
+template <typename T>
+void Bundle<T>::StopJournal()
+{
+    _journal.clear();
+    _journaling = false;
+}
+
+template <typename T>
+void Bundle<T>::RollBack()
+{
+    for (auto it = _journal.rbegin(); it != _journal.rend(); it++) {
+        if (*it < 0) {
+            _available_space--;
+            continue;
+        }
+        //undo Remove(name): the removed object sits right after the last one, swap it back
+        name name = *it;
+        T *target = _component_name[_available_space];
+        T *last = _component_name[name];
+        target->Name = name;
+        last->Name = _available_space;
+        _component_name[name] = target;
+        _component_name[_available_space] = last;
+        _available_space++;
+    }
+    StopJournal();
+}
+
 template <typename T>
 bool Bundle<T>::Exist(T *target)
 {
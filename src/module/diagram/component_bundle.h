@@ -11,6 +11,7 @@
 
 #include "component.h"
 #include <string>
+#include <vector>
 
 class RandomFactory;
 namespace diag {
@@ -23,6 +24,9 @@ class Bundle {
     T _component_bundle[MAX_BUNDLE];
     std::string _bundle_name;
     int _available_space;
+    bool _journaling;
+    //-1 for Add, the name of the removed object for Remove
+    std::vector<int> _journal;
 
   public:
     std::string BundleName();
@@ -39,6 +43,11 @@ class Bundle {
     int HowMany();
     T *RandomPick(RandomFactory &RNG);
     bool Exist(T *target);
+
+    //journal Add/Remove from now on, RollBack undoes them in reverse order with the original names
+    void StartJournal();
+    void StopJournal();
+    void RollBack();
 };
 }
 #endif /* defined(__Fermion_Simulator__component_bundle__) */
@@ -26,32 +26,37 @@ bool Diagram::IsWorm(vertex v)
 
 Diagram::Diagram()
     : Order(0)
-    , Phase(Complex(1.0, 0.0))
-    , Weight(Complex(1.0, 0.0))
+    , Phase(Amplitude(1.0))
+    , Weight(Amplitude(1.0))
     , G("GLine")
     , W("WLine")
     , Ver("nVer")
+    , _InTransaction(false)
 {
     Lat = nullptr;
 }
 
 bool Diagram::GHashCheck(Momentum k)
 {
-    return (GHash[k.index()]);
+    return GHash.Check(k.index());
 }
 
 void Diagram::AddGHash(Momentum k)
 {
-    if (DEBUGMODE && GHash[k.index()])
+    if (DEBUGMODE && GHash.Check(k.index()))
         ABORT("add occupied G Hash!");
-    GHash[k.index()] = true;
+    if (_InTransaction)
+        _GHashJournal.push_back(make_pair(k.index(), GHash.Check(k.index())));
+    GHash.Set(k.index(), true);
 }
 
 void Diagram::RemoveGHash(Momentum k)
 {
-    if (DEBUGMODE && !(GHash[k.index()]))
+    if (DEBUGMODE && !GHash.Check(k.index()))
         ABORT("remove empty G Hash!");
-    GHash[k.index()] = false;
+    if (_InTransaction)
+        _GHashJournal.push_back(make_pair(k.index(), GHash.Check(k.index())));
+    GHash.Set(k.index(), false);
 }
 
 void Diagram::ReplaceGHash(Momentum kold, Momentum k)
@@ -62,21 +67,25 @@ void Diagram::ReplaceGHash(Momentum kold, Momentum k)
 
 bool Diagram::WHashCheck(Momentum k)
 {
-    return (k == 0 || WHash[k.abs()]);
+    return (k == 0 || WHash.Check(k.abs()));
 }
 
 void Diagram::AddWHash(Momentum k)
 {
-    if (DEBUGMODE && WHash[k.abs()])
+    if (DEBUGMODE && WHash.Check(k.abs()))
         ABORT("add occupied W Hash!");
-    WHash[k.abs()] = true;
+    if (_InTransaction)
+        _WHashJournal.push_back(make_pair(k.abs(), WHash.Check(k.abs())));
+    WHash.Set(k.abs(), true);
 }
 
 void Diagram::RemoveWHash(Momentum k)
 {
-    if (DEBUGMODE && !(WHash[k.abs()]))
+    if (DEBUGMODE && !WHash.Check(k.abs()))
         ABORT("remove empty W Hash!");
-    WHash[k.abs()] = false;
+    if (_InTransaction)
+        _WHashJournal.push_back(make_pair(k.abs(), WHash.Check(k.abs())));
+    WHash.Set(k.abs(), false);
 }
 
 void Diagram::ReplaceWHash(Momentum kold, Momentum k)
@@ -95,12 +104,8 @@ void Diagram::Reset(Lattice& lat, weight::GClass& g, weight::WClass& w)
 
 void Diagram::ClearDiagram()
 {
-    for (int i = 0; i < 2 * MAX_K + 1; i++) {
-        GHash[i] = false;
-    }
-    for (int i = 0; i < MAX_K + 1; i++) {
-        WHash[i] = false;
-    }
+    GHash.Clear();
+    WHash.Clear();
 
     while (G.HowMany() > 0)
         G.Remove(G.HowMany() - 1);
@@ -121,7 +126,7 @@ bool Diagram::FixDiagram()
         Worm.Weight = weight::Worm::Weight(Worm.Ira->R, Worm.Masha->R, Worm.Ira->Tau, Worm.Masha->Tau);
     }
 
-    Weight = Complex(1.0, 0.0);
+    Weight = Amplitude(1.0);
     for (int index = 0; index < G.HowMany(); index++) {
         gLine g = G(index);
         vertex vin = g->NeighVer(IN);
@@ -159,3 +164,30 @@ bool Diagram::FixDiagram()
     Phase = phase(Weight);
     return true;
 }
+
+Amplitude Diagram::RescaledWeight(real factor, weight::GClass& GW, weight::WClass& WW)
+{
+    Amplitude weight(1.0);
+    for (int index = 0; index < G.HowMany(); index++) {
+        gLine g = G(index);
+        vertex vin = g->NeighVer(IN);
+        vertex vout = g->NeighVer(OUT);
+        weight *= GW.Weight(vin->R, vout->R, vin->Tau * factor, vout->Tau * factor, vin->Spin(OUT), vout->Spin(IN), g->IsMeasure);
+    }
+    for (int index = 0; index < W.HowMany(); index++) {
+        wLine w = W(index);
+        vertex vin = w->NeighVer(IN);
+        vertex vout = w->NeighVer(OUT);
+        weight *= WW.Weight(vin->R, vout->R, vin->Tau * factor, vout->Tau * factor, vin->Spin(), vout->Spin(), false, w->IsMeasure, w->IsDelta);
+    }
+    return weight * SignFermiLoop * (Order % 2 == 0 ? 1 : -1);
+}
+
+int Diagram::NumOfFreeTau()
+{
+    int num = Ver.HowMany();
+    for (int index = 0; index < W.HowMany(); index++)
+        if (W(index)->IsDelta)
+            num--;
+    return num;
+}
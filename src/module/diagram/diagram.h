@@ -10,7 +10,10 @@
 #define __Fermion_Simulator__diagram_global__
 
 #include <iosfwd>
+#include <vector>
+#include <utility>
 #include "component_bundle.h"
+#include "momentum_hash.h"
 #include "utility/rng.h"
 namespace weight {
 class GClass;
@@ -19,6 +22,37 @@ class WClass;
 class Dictionary;
 
 namespace diag {
+/**
+*  Position-independent copy of a diagram. Lines and vertices refer to each other by their names,
+*  and every field is stored in a plain array, so a snapshot is trivially copyable: it can be
+*  memcpy'ed between walkers or written to disk as it is. Weights, hash tables and the links
+*  from vertices to lines are not stored, Diagram::FromSnapshot rebuilds them with FixDiagram.
+*/
+class DiagramSnapshot {
+public:
+    int NVer, NG, NW;
+    real SignFermiLoop;
+
+    real VerTau[MAX_BUNDLE];
+    int VerCoordi[MAX_BUNDLE][D];
+    short VerSublat[MAX_BUNDLE];
+    char VerSpin[MAX_BUNDLE][2];
+
+    short GVer[MAX_BUNDLE][2];
+    int GK[MAX_BUNDLE];
+    bool GIsMeasure[MAX_BUNDLE];
+
+    short WVer[MAX_BUNDLE][2];
+    int WK[MAX_BUNDLE];
+    bool WIsDelta[MAX_BUNDLE];
+    bool WIsMeasure[MAX_BUNDLE];
+
+    bool WormExist;
+    short WormIra, WormMasha;
+    int WormK;
+    int WormdSpin;
+};
+
 class Diagram {
 public:
     Diagram();
@@ -27,25 +61,34 @@ public:
     bool FromDict(const Dictionary&, Lattice&, weight::GClass&, weight::WClass&);
     bool FromDict(const Dictionary&);
     Dictionary ToDict();
+    void ToSnapshot(DiagramSnapshot&);
+    //return false if the snapshot does not describe a diagram
+    bool FromSnapshot(const DiagramSnapshot&);
     void Reset(Lattice&, weight::GClass&, weight::WClass&);
     void SetTest(Lattice&, weight::GClass&, weight::WClass&);
     bool CheckDiagram();
     bool FixDiagram();
+    //weight with all Tau scaled by factor, e.g. to move the diagram to another Beta, evaluated with other G/W;
+    //the diagram is unchanged, only for diagrams without worm
+    Amplitude RescaledWeight(real factor, weight::GClass&, weight::WClass&);
+    //Tau variables of the diagram, the two vertices of a delta W share one
+    int NumOfFreeTau();
 
     Lattice* Lat;
     weight::GClass* GWeight;
     weight::WClass* WWeight;
 
     int Order;
-    Complex Phase, Weight;
+    Amplitude Phase, Weight;
     real SignFermiLoop;
 
     Bundle<GLine> G;
     Bundle<WLine> W;
     Bundle<Vertex> Ver;
 
-    bool GHash[2 * MAX_K + 1];
-    bool WHash[MAX_K + 1];
+    //G lines are keyed by k.index(), W lines by |k|
+    MomentumHash<2 * MAX_K + 1> GHash;
+    MomentumHash<MAX_K + 1> WHash;
 
     WormClass Worm;
     bool IsWorm(vertex);
@@ -68,23 +111,50 @@ public:
     void ReplaceGHash(Momentum, Momentum);
     void ReplaceWHash(Momentum, Momentum);
 
+    //Transaction: changes between Begin() and Commit() can be undone by RollBack() in O(changes).
+    //Add/Remove of G, W, Ver, the hash tables, Worm, Order, Phase and Weight are journaled automatically,
+    //a line or vertex has to be recorded with Record() before its fields are changed.
+    void Begin();
+    void Commit();
+    void RollBack();
+    bool InTransaction();
+    void Record(gLine);
+    void Record(wLine);
+    void Record(vertex);
+
     void WriteDiagram2gv(std::string);
 
 private:
+    bool _InTransaction;
+    int _OldOrder;
+    Amplitude _OldPhase, _OldWeight;
+    real _OldSignFermiLoop;
+    WormClass _OldWorm;
+    bool _OldMeasureGLine;
+    gLine _OldGMeasure;
+    wLine _OldWMeasure;
+    std::vector<std::pair<gLine, GLine> > _GJournal;
+    std::vector<std::pair<wLine, WLine> > _WJournal;
+    std::vector<std::pair<vertex, Vertex> > _VerJournal;
+    //index and old value of the changed hash entries
+    std::vector<std::pair<int, bool> > _GHashJournal;
+    std::vector<std::pair<int, bool> > _WHashJournal;
+
     bool _CheckTopo();
     bool _CheckStatus();
     bool _CheckK();
     bool _CheckSpin();
     bool _CheckWeight();
 
-    void _FromDict(const Dictionary&, wLine);
-    void _FromDict(const Dictionary&, gLine);
-    void _FromDict(const Dictionary&, vertex);
-    void _FromDict(const Dictionary& WormDict, WormClass& worm);
-    Dictionary _ToDict(WormClass);
-    Dictionary _ToDict(wLine);
-    Dictionary _ToDict(gLine);
-    Dictionary _ToDict(vertex);
+    //convert the index-th line or vertex of a snapshot from/to its dictionary
+    void _WFromDict(const Dictionary&, DiagramSnapshot&, int index);
+    void _GFromDict(const Dictionary&, DiagramSnapshot&, int index);
+    void _VerFromDict(const Dictionary&, DiagramSnapshot&, int index);
+    void _WormFromDict(const Dictionary&, DiagramSnapshot&);
+    Dictionary _WToDict(const DiagramSnapshot&, int index);
+    Dictionary _GToDict(const DiagramSnapshot&, int index);
+    Dictionary _VerToDict(const DiagramSnapshot&, int index);
+    Dictionary _WormToDict(const DiagramSnapshot&);
 };
 
 int TestDiagram();
@@ -17,120 +17,99 @@ using namespace std;
 using namespace diag;
 
 /*******************  Read/write diagram to dat file ****************/
-Dictionary Diagram::_ToDict(WormClass worm)
+Dictionary Diagram::_WormToDict(const DiagramSnapshot& snap)
 {
     Dictionary WormDict;
-    WormDict["Ira"] = worm.Ira->Name;
-    WormDict["Masha"] = worm.Masha->Name;
-    WormDict["dSpin"] = worm.dSpin;
-    WormDict["K"] = worm.K;
+    WormDict["Ira"] = (int)snap.WormIra;
+    WormDict["Masha"] = (int)snap.WormMasha;
+    WormDict["dSpin"] = snap.WormdSpin;
+    WormDict["K"] = snap.WormK;
     return WormDict;
 }
-void Diagram::_FromDict(const Dictionary& WormDict, WormClass& worm)
+void Diagram::_WormFromDict(const Dictionary& WormDict, DiagramSnapshot& snap)
 {
-    name ira, masha;
-    WormDict.Get("Ira", ira);
-    worm.Ira = Ver(ira);
-    WormDict.Get("Masha", masha);
-    worm.Masha = Ver(masha);
-    WormDict.Get("dSpin", worm.dSpin);
-    WormDict.Get("K", worm.K);
+    snap.WormIra = WormDict.Get<int>("Ira");
+    snap.WormMasha = WormDict.Get<int>("Masha");
+    snap.WormdSpin = WormDict.Get<int>("dSpin");
+    snap.WormK = WormDict.Get<int>("K");
 }
-Dictionary Diagram::_ToDict(gLine g)
+Dictionary Diagram::_GToDict(const DiagramSnapshot& snap, int index)
 {
     Dictionary GDict;
-    GDict["IN"] = g->nVer[IN]->Name;
-    GDict["OUT"] = g->nVer[OUT]->Name;
-    GDict["K"] = g->K;
-    GDict["IsMeasure"] = g->IsMeasure;
+    GDict["IN"] = (int)snap.GVer[index][IN];
+    GDict["OUT"] = (int)snap.GVer[index][OUT];
+    GDict["K"] = snap.GK[index];
+    GDict["IsMeasure"] = snap.GIsMeasure[index];
     return GDict;
 }
-void Diagram::_FromDict(const Dictionary& GDict, gLine g)
+void Diagram::_GFromDict(const Dictionary& GDict, DiagramSnapshot& snap, int index)
 {
-    name g_in, g_out;
-    GDict.Get("IN", g_in);
-    g->nVer[IN] = Ver(g_in);
-    GDict.Get("OUT", g_out);
-    g->nVer[OUT] = Ver(g_out);
-    GDict.Get("K", g->K);
-    AddGHash(g->K);
-    GDict.Get("IsMeasure", g->IsMeasure);
-    if (g->IsMeasure) {
-        MeasureGLine = true;
-        GMeasure = g;
-        WMeasure = nullptr;
-    }
+    snap.GVer[index][IN] = GDict.Get<int>("IN");
+    snap.GVer[index][OUT] = GDict.Get<int>("OUT");
+    snap.GK[index] = GDict.Get<int>("K");
+    snap.GIsMeasure[index] = GDict.Get<bool>("IsMeasure");
 }
 
-Dictionary Diagram::_ToDict(wLine w)
+Dictionary Diagram::_WToDict(const DiagramSnapshot& snap, int index)
 {
     Dictionary WDict;
-    WDict["IN"] = w->nVer[IN]->Name;
-    WDict["OUT"] = w->nVer[OUT]->Name;
-    WDict["K"] = w->K;
-    WDict["IsDelta"] = w->IsDelta;
-    WDict["IsMeasure"] = w->IsMeasure;
+    WDict["IN"] = (int)snap.WVer[index][IN];
+    WDict["OUT"] = (int)snap.WVer[index][OUT];
+    WDict["K"] = snap.WK[index];
+    WDict["IsDelta"] = snap.WIsDelta[index];
+    WDict["IsMeasure"] = snap.WIsMeasure[index];
     return WDict;
 }
-void Diagram::_FromDict(const Dictionary& WDict, wLine w)
+void Diagram::_WFromDict(const Dictionary& WDict, DiagramSnapshot& snap, int index)
 {
-    name w_in, w_out;
-    WDict.Get("IN", w_in);
-    w->nVer[IN] = Ver(w_in);
-    WDict.Get("OUT", w_out);
-    w->nVer[OUT] = Ver(w_out);
-    WDict.Get("K", w->K);
-    AddWHash(w->K);
-    WDict.Print();
-    WDict.Get("IsDelta", w->IsDelta);
-    WDict.Get("IsMeasure", w->IsMeasure);
-    if (w->IsMeasure) {
-        MeasureGLine = false;
-        GMeasure = nullptr;
-        WMeasure = w;
-    }
+    snap.WVer[index][IN] = WDict.Get<int>("IN");
+    snap.WVer[index][OUT] = WDict.Get<int>("OUT");
+    snap.WK[index] = WDict.Get<int>("K");
+    snap.WIsDelta[index] = WDict.Get<bool>("IsDelta");
+    snap.WIsMeasure[index] = WDict.Get<bool>("IsMeasure");
 }
-Dictionary Diagram::_ToDict(vertex v)
+Dictionary Diagram::_VerToDict(const DiagramSnapshot& snap, int index)
 {
     Dictionary VerDict;
-    VerDict["Name"] = v->Name;
-    VerDict["Sublat"] = v->R.Sublattice;
-    VerDict["Coordi"] = v->R.Coordinate;
-    VerDict["Tau"] = v->Tau;
-    VerDict["SpinIn"] = (int)v->Spin(IN);
-    VerDict["SpinOut"] = (int)v->Spin(OUT);
+    VerDict["Name"] = index;
+    VerDict["Sublat"] = (int)snap.VerSublat[index];
+    VerDict["Coordi"] = Vec<int>((int*)snap.VerCoordi[index]);
+    VerDict["Tau"] = snap.VerTau[index];
+    VerDict["SpinIn"] = (int)snap.VerSpin[index][IN];
+    VerDict["SpinOut"] = (int)snap.VerSpin[index][OUT];
     return VerDict;
 }
-void Diagram::_FromDict(const Dictionary& VerDict, vertex v)
+void Diagram::_VerFromDict(const Dictionary& VerDict, DiagramSnapshot& snap, int index)
 {
-    VerDict.Get("Name", v->Name);
-    VerDict.Get("Sublat", v->R.Sublattice);
-    VerDict.Get("Coordi", v->R.Coordinate);
-    VerDict.Get("Tau", v->Tau);
-    int spinin, spinout;
-    VerDict.Get("SpinIn", spinin);
-    VerDict.Get("SpinOut", spinout);
-    v->_spin[IN] = spin(spinin);
-    v->_spin[OUT] = spin(spinout);
+    ASSERT_ALLWAYS(VerDict.Get<int>("Name") == index, "Vertex " << index << " is not stored in order!");
+    snap.VerSublat[index] = VerDict.Get<int>("Sublat");
+    auto coordi = VerDict.Get<Vec<int> >("Coordi");
+    for (int d = 0; d < D; d++)
+        snap.VerCoordi[index][d] = coordi[d];
+    snap.VerTau[index] = VerDict.Get<real>("Tau");
+    snap.VerSpin[index][IN] = VerDict.Get<int>("SpinIn");
+    snap.VerSpin[index][OUT] = VerDict.Get<int>("SpinOut");
 }
 
 Dictionary Diagram::ToDict()
 {
+    DiagramSnapshot snap;
+    ToSnapshot(snap);
     Dictionary Config;
     vector<Dictionary> VerList, GList, WList;
-    for (int index = 0; index < Ver.HowMany(); index++)
-        VerList.push_back(_ToDict(Ver(index)));
+    for (int index = 0; index < snap.NVer; index++)
+        VerList.push_back(_VerToDict(snap, index));
     Config["Ver"] = VerList;
-    for (int index = 0; index < G.HowMany(); index++)
-        GList.push_back(_ToDict(G(index)));
+    for (int index = 0; index < snap.NG; index++)
+        GList.push_back(_GToDict(snap, index));
     Config["G"] = GList;
-    for (int index = 0; index < W.HowMany(); index++)
-        WList.push_back(_ToDict(W(index)));
+    for (int index = 0; index < snap.NW; index++)
+        WList.push_back(_WToDict(snap, index));
     Config["W"] = WList;
-    if (Worm.Exist) {
-        Config["Worm"] = _ToDict(Worm);
+    if (snap.WormExist) {
+        Config["Worm"] = _WormToDict(snap);
     }
-    Config["SignFermiLoop"] = SignFermiLoop;
+    Config["SignFermiLoop"] = snap.SignFermiLoop;
     return Config;
 }
 
@@ -142,20 +121,26 @@ bool Diagram::FromDict(const Dictionary& dict, Lattice& lat, weight::GClass& g,
 
 bool Diagram::FromDict(const Dictionary& Config)
 {
-    ClearDiagram();
-    for (auto& dict : Config.Get<vector<Dictionary> >("Ver"))
-        _FromDict(dict, Ver.Add());
-    for (auto& dict : Config.Get<vector<Dictionary> >("W"))
-        _FromDict(dict, W.Add());
-    for (auto& dict : Config.Get<vector<Dictionary> >("G"))
-        _FromDict(dict, G.Add());
-    Worm.Exist = Config.HasKey("Worm");
-    if (Config.HasKey("Worm")) {
-        _FromDict(Config.Get<Dictionary>("Worm"), Worm);
-    }
-    SignFermiLoop = Config.Get<real>("SignFermiLoop");
-    FixDiagram();
-    return true;
+    DiagramSnapshot snap;
+    auto VerList = Config.Get<vector<Dictionary> >("Ver");
+    auto GList = Config.Get<vector<Dictionary> >("G");
+    auto WList = Config.Get<vector<Dictionary> >("W");
+    ASSERT_ALLWAYS(VerList.size() <= MAX_BUNDLE && GList.size() <= MAX_BUNDLE && WList.size() <= MAX_BUNDLE,
+                   "Too many objects >=" << MAX_BUNDLE);
+    snap.NVer = VerList.size();
+    snap.NG = GList.size();
+    snap.NW = WList.size();
+    for (int index = 0; index < snap.NVer; index++)
+        _VerFromDict(VerList[index], snap, index);
+    for (int index = 0; index < snap.NW; index++)
+        _WFromDict(WList[index], snap, index);
+    for (int index = 0; index < snap.NG; index++)
+        _GFromDict(GList[index], snap, index);
+    snap.WormExist = Config.HasKey("Worm");
+    if (snap.WormExist)
+        _WormFromDict(Config.Get<Dictionary>("Worm"), snap);
+    snap.SignFermiLoop = Config.Get<real>("SignFermiLoop");
+    return FromSnapshot(snap);
 }
 
 void Diagram::BuildNew(Lattice& lat, weight::GClass& g, weight::WClass& w)
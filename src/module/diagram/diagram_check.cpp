@@ -144,8 +144,8 @@ bool Diagram::_CheckWeight()
     if (Order == 0)
         return Equal(Weight, weight::Norm::Weight());
     else {
-        Complex DiagWeight(1.0, 0.0);
-        Complex gWeight, wWeight;
+        Amplitude DiagWeight(1.0);
+        Amplitude gWeight, wWeight;
         vertex vin, vout;
 
         for (int i = 0; i < G.HowMany(); i++) {
@@ -157,7 +157,7 @@ bool Diagram::_CheckWeight()
                                       vin->Spin(OUT), vout->Spin(IN), G(i)->IsMeasure);
             if (!Equal(G(i)->Weight, gWeight))
                 return false;
-            if (Equal(G(i)->Weight, Complex(0.0, 0.0)))
+            if (Equal(G(i)->Weight, Amplitude(0.0)))
                 return false;
         }
         for (int i = 0; i < W.HowMany(); i++) {
@@ -169,7 +169,7 @@ bool Diagram::_CheckWeight()
                                       vout->Spin(), W(i)->IsWorm, W(i)->IsMeasure, W(i)->IsDelta);
             if (!Equal(W(i)->Weight, wWeight))
                 return false;
-            if (Equal(W(i)->Weight, Complex(0.0, 0.0)))
+            if (Equal(W(i)->Weight, Amplitude(0.0)))
                 return false;
         }
         DiagWeight *= SignFermiLoop * (Order % 2 == 0 ? 1 : -1);
@@ -0,0 +1,105 @@
+//
+//  diagram_journal.cpp
+//  Feynman_Simulator
+//
+
+#include "diagram.h"
+#include "utility/abort.h"
+
+using namespace std;
+using namespace diag;
+
+void Diagram::Begin()
+{
+    if (DEBUGMODE && _InTransaction)
+        ABORT("Transactions can not be nested!");
+    _InTransaction = true;
+    _OldOrder = Order;
+    _OldPhase = Phase;
+    _OldWeight = Weight;
+    _OldSignFermiLoop = SignFermiLoop;
+    _OldWorm = Worm;
+    _OldMeasureGLine = MeasureGLine;
+    _OldGMeasure = GMeasure;
+    _OldWMeasure = WMeasure;
+    G.StartJournal();
+    W.StartJournal();
+    Ver.StartJournal();
+}
+
+void Diagram::Commit()
+{
+    if (DEBUGMODE && !_InTransaction)
+        ABORT("No transaction to commit!");
+    _InTransaction = false;
+    _GJournal.clear();
+    _WJournal.clear();
+    _VerJournal.clear();
+    _GHashJournal.clear();
+    _WHashJournal.clear();
+    G.StopJournal();
+    W.StopJournal();
+    Ver.StopJournal();
+}
+
+/**
+*  restore the recorded components in reverse order, then undo Add/Remove of the bundles,
+*  which also restores the names of the components involved
+*/
+void Diagram::RollBack()
+{
+    if (DEBUGMODE && !_InTransaction)
+        ABORT("No transaction to roll back!");
+    _InTransaction = false;
+    for (auto it = _GJournal.rbegin(); it != _GJournal.rend(); it++)
+        *(it->first) = it->second;
+    for (auto it = _WJournal.rbegin(); it != _WJournal.rend(); it++)
+        *(it->first) = it->second;
+    for (auto it = _VerJournal.rbegin(); it != _VerJournal.rend(); it++)
+        *(it->first) = it->second;
+    for (auto it = _GHashJournal.rbegin(); it != _GHashJournal.rend(); it++)
+        GHash.Set(it->first, it->second);
+    for (auto it = _WHashJournal.rbegin(); it != _WHashJournal.rend(); it++)
+        WHash.Set(it->first, it->second);
+    G.RollBack();
+    W.RollBack();
+    Ver.RollBack();
+
+    Order = _OldOrder;
+    Phase = _OldPhase;
+    Weight = _OldWeight;
+    SignFermiLoop = _OldSignFermiLoop;
+    Worm = _OldWorm;
+    MeasureGLine = _OldMeasureGLine;
+    GMeasure = _OldGMeasure;
+    WMeasure = _OldWMeasure;
+
+    _GJournal.clear();
+    _WJournal.clear();
+    _VerJournal.clear();
+    _GHashJournal.clear();
+    _WHashJournal.clear();
+}
+
+bool Diagram::InTransaction()
+{
+    return _InTransaction;
+}
+
+void Diagram::Record(gLine g)
+{
+    if (_InTransaction)
+        _GJournal.push_back(make_pair(g, *g));
+}
+
+void Diagram::Record(wLine w)
+{
+    if (_InTransaction)
+        _WJournal.push_back(make_pair(w, *w));
+}
+
+void Diagram::Record(vertex v)
+{
+    if (_InTransaction)
+        _VerJournal.push_back(make_pair(v, *v));
+}
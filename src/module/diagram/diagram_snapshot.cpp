@@ -0,0 +1,119 @@
+//
+//  diagram_snapshot.cpp
+//  Feynman_Simulator
+//
+
+#include "diagram.h"
+#include "utility/abort.h"
+#include <type_traits>
+#include <limits>
+
+using namespace std;
+using namespace diag;
+
+static_assert(is_trivially_copyable<DiagramSnapshot>::value, "DiagramSnapshot should be copyable with memcpy!");
+static_assert(MAX_BUNDLE <= numeric_limits<short>::max(), "names of vertices do not fit in DiagramSnapshot!");
+
+void Diagram::ToSnapshot(DiagramSnapshot& snap)
+{
+    snap.NVer = Ver.HowMany();
+    snap.NG = G.HowMany();
+    snap.NW = W.HowMany();
+    snap.SignFermiLoop = SignFermiLoop;
+    for (int index = 0; index < snap.NVer; index++) {
+        vertex v = Ver(index);
+        snap.VerTau[index] = v->Tau;
+        for (int d = 0; d < D; d++)
+            snap.VerCoordi[index][d] = v->R.Coordinate[d];
+        snap.VerSublat[index] = v->R.Sublattice;
+        snap.VerSpin[index][IN] = v->_spin[IN];
+        snap.VerSpin[index][OUT] = v->_spin[OUT];
+    }
+    for (int index = 0; index < snap.NG; index++) {
+        gLine g = G(index);
+        snap.GVer[index][IN] = g->nVer[IN]->Name;
+        snap.GVer[index][OUT] = g->nVer[OUT]->Name;
+        snap.GK[index] = g->K.K;
+        snap.GIsMeasure[index] = g->IsMeasure;
+    }
+    for (int index = 0; index < snap.NW; index++) {
+        wLine w = W(index);
+        snap.WVer[index][IN] = w->nVer[IN]->Name;
+        snap.WVer[index][OUT] = w->nVer[OUT]->Name;
+        snap.WK[index] = w->K.K;
+        snap.WIsDelta[index] = w->IsDelta;
+        snap.WIsMeasure[index] = w->IsMeasure;
+    }
+    snap.WormExist = Worm.Exist;
+    if (Worm.Exist) {
+        snap.WormIra = Worm.Ira->Name;
+        snap.WormMasha = Worm.Masha->Name;
+        snap.WormK = Worm.K.K;
+        snap.WormdSpin = Worm.dSpin;
+    }
+}
+
+/**
+*  rebuild the diagram from a snapshot; the bundles are refilled in the order of the snapshot,
+*  so every line and vertex gets back its old name
+*/
+bool Diagram::FromSnapshot(const DiagramSnapshot& snap)
+{
+    auto IsVertex = [&](int name) { return name >= 0 && name < snap.NVer; };
+    if (snap.NVer < 0 || snap.NVer > MAX_BUNDLE || snap.NG < 0 || snap.NG > MAX_BUNDLE || snap.NW < 0 || snap.NW > MAX_BUNDLE)
+        return false;
+    for (int index = 0; index < snap.NG; index++)
+        if (!IsVertex(snap.GVer[index][IN]) || !IsVertex(snap.GVer[index][OUT]))
+            return false;
+    for (int index = 0; index < snap.NW; index++)
+        if (!IsVertex(snap.WVer[index][IN]) || !IsVertex(snap.WVer[index][OUT]))
+            return false;
+    if (snap.WormExist && (!IsVertex(snap.WormIra) || !IsVertex(snap.WormMasha)))
+        return false;
+    ClearDiagram();
+    for (int index = 0; index < snap.NVer; index++) {
+        vertex v = Ver.Add();
+        v->Tau = snap.VerTau[index];
+        v->R.Sublattice = snap.VerSublat[index];
+        v->R.Coordinate = Vec<int>(snap.VerCoordi[index]);
+        v->_spin[IN] = spin(snap.VerSpin[index][IN]);
+        v->_spin[OUT] = spin(snap.VerSpin[index][OUT]);
+    }
+    for (int index = 0; index < snap.NW; index++) {
+        wLine w = W.Add();
+        w->nVer[IN] = Ver(snap.WVer[index][IN]);
+        w->nVer[OUT] = Ver(snap.WVer[index][OUT]);
+        w->K = snap.WK[index];
+        AddWHash(w->K);
+        w->IsDelta = snap.WIsDelta[index];
+        w->IsMeasure = snap.WIsMeasure[index];
+        if (w->IsMeasure) {
+            MeasureGLine = false;
+            GMeasure = nullptr;
+            WMeasure = w;
+        }
+    }
+    for (int index = 0; index < snap.NG; index++) {
+        gLine g = G.Add();
+        g->nVer[IN] = Ver(snap.GVer[index][IN]);
+        g->nVer[OUT] = Ver(snap.GVer[index][OUT]);
+        g->K = snap.GK[index];
+        AddGHash(g->K);
+        g->IsMeasure = snap.GIsMeasure[index];
+        if (g->IsMeasure) {
+            MeasureGLine = true;
+            GMeasure = g;
+            WMeasure = nullptr;
+        }
+    }
+    Worm.Exist = snap.WormExist;
+    if (snap.WormExist) {
+        Worm.Ira = Ver(snap.WormIra);
+        Worm.Masha = Ver(snap.WormMasha);
+        Worm.K = snap.WormK;
+        Worm.dSpin = snap.WormdSpin;
+    }
+    SignFermiLoop = snap.SignFermiLoop;
+    FixDiagram();
+    return true;
+}
@@ -8,13 +8,18 @@
 
 #include "diagram.h"
 #include "utility/sput.h"
+#include "utility/dictionary.h"
 #include "module/weight/component.h"
+#include <cstring>
 using namespace std;
 using namespace diag;
 
 void Test_Diagram_Component();
 void Test_Diagram_Component_Bundle();
 void Test_Diagram_IO();
+void Test_Diagram_Journal();
+void Test_Diagram_Snapshot();
+void Test_Momentum_Hash();
 
 int diag::TestDiagram()
 {
@@ -23,6 +28,9 @@ int diag::TestDiagram()
     sput_run_test(Test_Diagram_Component);
     sput_run_test(Test_Diagram_Component_Bundle);
     sput_run_test(Test_Diagram_IO);
+    sput_run_test(Test_Diagram_Journal);
+    sput_run_test(Test_Diagram_Snapshot);
+    sput_run_test(Test_Momentum_Hash);
     sput_finish_testing();
     return sput_get_return_value();
 }
@@ -93,3 +101,145 @@ void Test_Diagram_IO()
     Diag.WriteDiagram2gv("./test.gv");
     //system("rm ./test.gv");
 }
+
+bool SameGLines(Diagram& Diag, const vector<GLine>& Old)
+{
+    if (Diag.G.HowMany() != int(Old.size()))
+        return false;
+    for (int i = 0; i < Diag.G.HowMany(); i++) {
+        gLine g = Diag.G(i);
+        if (g->Name != Old[i].Name || g->K != Old[i].K || g->nVer[IN] != Old[i].nVer[IN]
+            || g->nVer[OUT] != Old[i].nVer[OUT] || !Equal(g->Weight, Old[i].Weight))
+            return false;
+    }
+    return true;
+}
+
+void Test_Diagram_Journal()
+{
+    Lattice lat(Vec<int>(8));
+    weight::GClass G(lat, 1.0, 32);
+    weight::WClass W(lat, 1.0, 32);
+    G.BuildTest();
+    W.BuildTest();
+    Diagram Diag;
+    Diag.SetTest(lat, G, W);
+
+    vector<GLine> OldG;
+    for (int i = 0; i < Diag.G.HowMany(); i++)
+        OldG.push_back(*Diag.G(i));
+    int OldWNumber = Diag.W.HowMany(), OldVerNumber = Diag.Ver.HowMany();
+    Momentum OldWK = Diag.W(0)->K;
+    real OldTau = Diag.Ver(0)->Tau;
+    Amplitude OldWeight = Diag.Weight;
+
+    Diag.Begin();
+    gLine g0 = Diag.G(0);
+    Diag.Record(g0);
+    Diag.ReplaceGHash(g0->K, Momentum(7));
+    g0->K = 7;
+    g0->Weight *= 2.0;
+    Diag.Ver.Add();
+    Diag.AddGHash(Momentum(9));
+    Diag.G.Add()->K = 9;
+    wLine w = Diag.W(0);
+    Diag.RemoveWHash(w->K);
+    Diag.W.Remove(w);
+    Diag.G.Remove(Diag.G(1));
+    Diag.Record(Diag.Ver(0));
+    Diag.Ver(0)->Tau = 0.3;
+    Diag.Worm.Exist = true;
+    Diag.Order++;
+    Diag.Weight *= 2.0;
+    Diag.RollBack();
+
+    sput_fail_unless(SameGLines(Diag, OldG), "Check G lines after rolling back");
+    sput_fail_unless(Diag.W.HowMany() == OldWNumber && Diag.Ver.HowMany() == OldVerNumber,
+                     "Check W and Ver bundles after rolling back");
+    sput_fail_unless(Diag.GHashCheck(OldG[0].K) && !Diag.GHashCheck(Momentum(7)) && !Diag.GHashCheck(Momentum(9)),
+                     "Check G hash after rolling back");
+    sput_fail_unless(Diag.WHashCheck(OldWK), "Check W hash after rolling back");
+    sput_fail_unless(Equal(Diag.Ver(0)->Tau, OldTau) && !Diag.Worm.Exist && Equal(Diag.Weight, OldWeight),
+                     "Check vertex, worm and weight after rolling back");
+    sput_fail_unless(Diag.CheckDiagram(), "Check diagram after rolling back");
+
+    Diag.Begin();
+    Diag.Record(Diag.Ver(0));
+    Diag.Ver(0)->Tau = 0.3;
+    Diag.Commit();
+    sput_fail_unless(Equal(Diag.Ver(0)->Tau, 0.3) && !Diag.InTransaction(), "Check committed change");
+}
+
+void Test_Diagram_Snapshot()
+{
+    Lattice lat(Vec<int>(8));
+    weight::GClass G(lat, 1.0, 32);
+    weight::WClass W(lat, 1.0, 32);
+    G.BuildTest();
+    W.BuildTest();
+    Diagram Diag;
+    Diag.SetTest(lat, G, W);
+    Diag.Worm = WormClass(Diag.Ver(0), Diag.Ver(1), 0, 0);
+    Diag.FixDiagram();
+
+    DiagramSnapshot Snap, Copy;
+    Diag.ToSnapshot(Snap);
+    memcpy(&Copy, &Snap, sizeof(DiagramSnapshot));
+    vector<GLine> OldG;
+    for (int i = 0; i < Diag.G.HowMany(); i++)
+        OldG.push_back(*Diag.G(i));
+    Amplitude OldWeight = Diag.Weight;
+    string OldConfig = Diag.ToDict().PrettyString();
+
+    Diag.ClearDiagram();
+    Diag.BuildNew(lat, G, W);
+    Diag.FromSnapshot(Copy);
+    sput_fail_unless(Diag.G.HowMany() == int(OldG.size()) && Diag.G(0)->K == OldG[0].K && Diag.G(1)->K == OldG[1].K,
+                     "Check G lines restored from a copied snapshot");
+    sput_fail_unless(Diag.Worm.Exist && Diag.Worm.Ira == Diag.Ver(0) && Diag.Worm.Masha == Diag.Ver(1),
+                     "Check worm restored from a copied snapshot");
+    sput_fail_unless(Equal(Diag.Weight, OldWeight) && Diag.CheckDiagram(), "Check diagram restored from a copied snapshot");
+    sput_fail_unless(Diag.ToDict().PrettyString() == OldConfig, "Check dictionary of the restored diagram");
+
+    //a replica exchange predicts the weight of a diagram rescaled in Tau before it copies the diagram
+    Copy.WormExist = false;
+    Diag.FromSnapshot(Copy);
+    Amplitude Rescaled = Diag.RescaledWeight(0.5, G, W);
+    for (int i = 0; i < Copy.NVer; i++)
+        Copy.VerTau[i] *= 0.5;
+    sput_fail_unless(Diag.FromSnapshot(Copy) && Equal(Diag.Weight, Rescaled), "Check the weight of a diagram rescaled in Tau");
+}
+
+void Test_Momentum_Hash()
+{
+    const int Range = 2 * MAX_K + 1;
+    BitsetHash<Range> Bits;
+    OpenHash<Range> Open;
+    RandomFactory RNG;
+    RNG.Reset(519180543);
+    vector<int> Keys;
+    bool flag = true;
+    for (int step = 0; step < 100000 && flag; step++) {
+        if (Keys.size() < MAX_BUNDLE && (Keys.empty() || RNG.urn() < 0.5)) {
+            //nearby momenta collide in the home slots most often
+            int key = RNG.irn(MAX_K - 3 * MAX_BUNDLE, MAX_K + 3 * MAX_BUNDLE);
+            if (Bits.Check(key))
+                continue;
+            Bits.Set(key, true);
+            Open.Set(key, true);
+            Keys.push_back(key);
+        }
+        else {
+            int i = RNG.irn(0, Keys.size() - 1);
+            Bits.Set(Keys[i], false);
+            Open.Set(Keys[i], false);
+            Keys[i] = Keys.back();
+            Keys.pop_back();
+        }
+        for (int key = MAX_K - 3 * MAX_BUNDLE; key <= MAX_K + 3 * MAX_BUNDLE; key++)
+            flag = flag && (Bits.Check(key) == Open.Check(key));
+    }
+    sput_fail_unless(flag, "Check open addressing set against bitset");
+    Open.Clear();
+    sput_fail_unless(Keys.empty() || !Open.Check(Keys[0]), "Check cleared open addressing set");
+}
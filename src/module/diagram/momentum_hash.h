@@ -0,0 +1,140 @@
+//
+//  momentum_hash.h
+//  Feynman_Simulator
+//
+
+#ifndef __Feynman_Simulator__momentum_hash__
+#define __Feynman_Simulator__momentum_hash__
+
+#include <bitset>
+#include "utility/abort.h"
+#include "component_bundle.h"
+
+namespace diag {
+
+/**
+*  Occupancy of the momentum keys in [0, Range), one bit per key.
+*  Clear is O(Range/64), Check/Set touch a single word.
+*/
+template <int Range>
+class BitsetHash {
+  public:
+    void Clear()
+    {
+        _Bits.reset();
+    }
+    bool Check(int key) const
+    {
+        if (DEBUGMODE && (key < 0 || key >= Range))
+            ABORT("Momentum key " << key << " is out of the range [0," << Range << ")");
+        return _Bits[key];
+    }
+    void Set(int key, bool occupied)
+    {
+        if (DEBUGMODE && (key < 0 || key >= Range))
+            ABORT("Momentum key " << key << " is out of the range [0," << Range << ")");
+        _Bits[key] = occupied;
+    }
+
+  private:
+    std::bitset<Range> _Bits;
+};
+
+//smallest power of two not less than n
+constexpr int NextPowerOfTwo(int n, int p = 1)
+{
+    return p >= n ? p : NextPowerOfTwo(n, 2 * p);
+}
+
+/**
+*  Occupancy of the momentum keys in [0, Range) as a linear probing set, sized so that
+*  all the lines of a diagram (at most MAX_BUNDLE) fill no more than half of it.
+*  Erase shifts the following keys back instead of leaving tombstones, so Check always
+*  stops at the first empty slot.
+*/
+template <int Range>
+class OpenHash {
+    static_assert(Range <= 32767, "momentum keys should fit in a short!");
+
+  public:
+    static const int Capacity = NextPowerOfTwo(2 * MAX_BUNDLE);
+
+    OpenHash()
+    {
+        Clear();
+    }
+    void Clear()
+    {
+        for (int i = 0; i < Capacity; i++)
+            _Key[i] = EMPTY;
+        _Size = 0;
+    }
+    bool Check(int key) const
+    {
+        return _Key[_Find(key)] == key;
+    }
+    void Set(int key, bool occupied)
+    {
+        if (DEBUGMODE && (key < 0 || key >= Range))
+            ABORT("Momentum key " << key << " is out of the range [0," << Range << ")");
+        int slot = _Find(key);
+        if (occupied == (_Key[slot] == key))
+            return;
+        if (occupied) {
+            ASSERT_ALLWAYS(_Size < Capacity - 1, "Too many momenta >=" << Capacity - 1);
+            _Key[slot] = key;
+            _Size++;
+            return;
+        }
+        //move back every following key that may not be probed past the freed slot any more
+        int next = slot;
+        while (true) {
+            next = (next + 1) & (Capacity - 1);
+            if (_Key[next] == EMPTY)
+                break;
+            int home = _Home(_Key[next]);
+            bool between = (slot <= next) ? (slot < home && home <= next) : (slot < home || home <= next);
+            if (!between) {
+                _Key[slot] = _Key[next];
+                slot = next;
+            }
+        }
+        _Key[slot] = EMPTY;
+        _Size--;
+    }
+
+  private:
+    static const short EMPTY = -1;
+    short _Key[Capacity];
+    int _Size;
+
+    int _Home(int key) const
+    {
+        //Fibonacci hashing, the top bits of the product spread successive momenta apart
+        return (unsigned(key) * 2654435769u) >> (32 - _Log2(Capacity));
+    }
+    //slot of the key, or the empty slot where it would be inserted
+    int _Find(int key) const
+    {
+        int slot = _Home(key);
+        while (_Key[slot] != key && _Key[slot] != EMPTY)
+            slot = (slot + 1) & (Capacity - 1);
+        return slot;
+    }
+    static constexpr int _Log2(int n)
+    {
+        return n <= 1 ? 0 : 1 + _Log2(n / 2);
+    }
+};
+
+//cmake -DMOMENTUM_BITSET=ON to keep one bit per momentum instead of the open addressing set
+#ifdef MOMENTUM_BITSET
+template <int Range>
+using MomentumHash = BitsetHash<Range>;
+#else
+template <int Range>
+using MomentumHash = OpenHash<Range>;
+#endif
+}
+
+#endif /* defined(__Feynman_Simulator__momentum_hash__) */
@@ -11,6 +11,8 @@
 #include "math.h"
 #include "utility/utility.h"
 #include "utility/momentum.h"
+#include "utility/timer.h"
+#include "utility/dictionary.h"
 #include "module/diagram/diagram.h"
 #include "module/parameter/parameter.h"
 #include "lattice/lattice.h"
@@ -28,23 +30,65 @@ using namespace mc;
 bool CanNotMoveWorm(int dspin, spin sin, spin sout);
 bool CanNotMoveWorm(int dspin, spin sin, int dir);
 
+//updates accepted less often than TargetAcceptRatio are called proportionally less often
+const real TargetAcceptRatio = 0.1;
+//but never less than MinUpdateWeight, to keep the Markov chain ergodic
+const real MinUpdateWeight = 0.05;
+//proposals needed before the acceptance ratio of an update is trusted
+const real MinProposedToTune = 1000.0;
+//share of the uniform distribution mixed into the tau proposal from |G|, so that no tau is unreachable
+const real TauUniformShare = 0.1;
+//the same for the site proposal from |W|
+const real SiteUniformShare = 0.1;
+
+/**
+*  replace the upper bound maxweight of a new line weight in bound with the real weight,
+*  return true if the random number u already rules out the acceptance
+*/
+inline bool RejectEarly(real u, real& bound, const Amplitude& weight, real maxweight)
+{
+    bound = (maxweight > 0.0 ? bound * mod(weight) / maxweight : 0.0);
+    return u >= bound;
+}
+
+/**
+*  count an update which returns before its Metropolis step
+*/
+void Markov::_Reject(Operations op, Rejections reason)
+{
+    Rejected[op][reason][Diag->Order] += 1.0;
+}
+
 bool Markov::BuildNew(ParaMC &para, Diagram &diag, weight::Weight &weight)
 {
     Reset(para, diag, weight);
     ASSERT_ALLWAYS(NUpdates >= (int)Operations::END,
                    "NUpdates " << NUpdates << " should larger than " << (int)Operations::END);
 
-    InitialArray(ProbofCall, 0.0, NUpdates);
-    InitialArray(SumofProbofCall, 0.0, NUpdates);
-
-    for (int i = 0; i < NUpdates; i++) {
-        ProbofCall[i] = 1.0 / real(NUpdates);
-        for (int j = i; j < NUpdates; j++)
-            SumofProbofCall[j] += ProbofCall[i];
+    InitialArray(UpdateWeight, 1.0, NUpdates);
+    //disabled updates
+    UpdateWeight[CHANGE_SPIN_VERTEX] = 0.0;
+    if (para.UpdateWeight.size() == NUpdates) {
+        //the table has been tuned and frozen in a previous run, tuning never disables an update,
+        //so a table which disables an update enabled here was saved before it was enabled
+        bool IsStale = false;
+        for (int op = 0; op < NUpdates; op++)
+            IsStale |= (UpdateWeight[op] > 0.0 && para.UpdateWeight[op] <= 0.0);
+        if (IsStale) {
+            LOG_WARNING("The saved update weights disable an update, tune them again!");
+            para.UpdateWeight.clear();
+        }
+        else
+            std::copy(para.UpdateWeight.begin(), para.UpdateWeight.end(), UpdateWeight);
     }
+    _BuildUpdateTable();
 
     InitialArray(&Accepted[0][0], 0.0, NUpdates * MAX_ORDER);
     InitialArray(&Proposed[0][0], 0.0, NUpdates * MAX_ORDER);
+    InitialArray(&Cycles[0][0], 0.0, NUpdates * MAX_ORDER);
+    HopCycles = 0.0;
+    InitialArray(&Rejected[0][0][0], 0.0, NUpdates * NRejections * MAX_ORDER);
+    ClearCost();
 
     OperationName[CREATE_WORM] = NAME(CREATE_WORM);
     OperationName[DELETE_WORM] = NAME(DELETE_WORM);
@@ -65,6 +109,17 @@ bool Markov::BuildNew(ParaMC &para, Diagram &diag, weight::Weight &weight)
     OperationName[CHANGE_SPIN_VERTEX] = NAME(CHANGE_SPIN_VERTEX);
     OperationName[JUMP_TO_ORDER0] = NAME(JUMP_TO_ORDER0);
     OperationName[JUMP_BACK_TO_ORDER1] = NAME(JUMP_BACK_TO_ORDER1);
+
+    RejectionName[WRONG_SECTOR] = NAME(WRONG_SECTOR);
+    RejectionName[HASH_COLLISION] = NAME(HASH_COLLISION);
+    RejectionName[SPIN_CONFLICT] = NAME(SPIN_CONFLICT);
+    RejectionName[MEASURE_LINE] = NAME(MEASURE_LINE);
+    RejectionName[DELTA_LINE] = NAME(DELTA_LINE);
+    RejectionName[WORM_LINE] = NAME(WORM_LINE);
+    RejectionName[TOPOLOGY] = NAME(TOPOLOGY);
+    RejectionName[SITE_MISMATCH] = NAME(SITE_MISMATCH);
+    RejectionName[WEIGHT_BOUND] = NAME(WEIGHT_BOUND);
+    RejectionName[OUT_OF_RANGE] = NAME(OUT_OF_RANGE);
     return true;
 }
 
@@ -77,6 +132,11 @@ void Markov::Reset(ParaMC &para, Diagram &diag, weight::Weight &weight)
     OrderReWeight = para.OrderReWeight.data();
     WormSpaceReweight = &para.WormSpaceReweight;
     PolarReweight = &para.PolarReweight;
+    TauTrials = para.TauTrials;
+    ASSERT_ALLWAYS(TauTrials >= 1 && TauTrials <= MAX_TAU_TRIALS,
+                   "TauTrials should be in [1, " << MAX_TAU_TRIALS << "]");
+    CostTiming = para.CostReWeight;
+    FrozenUpdateWeight = &para.UpdateWeight;
     Diag = &diag;
     Worm = &diag.Worm;
     Sigma = weight.Sigma;
@@ -84,30 +144,119 @@ void Markov::Reset(ParaMC &para, Diagram &diag, weight::Weight &weight)
     G = weight.G;
     W = weight.W;
     RNG = &para.RNG;
+    GMaxWeight = G->MaxAbsWeight();
+    WMaxWeight = W->MaxAbsWeight();
+    MaxTauBin = para.MaxTauBin;
+    NSublat = para.NSublat;
+    _BuildTauTable();
+    _BuildSiteTable();
+}
+
+/**
+*  G decays away from tau=0 and tau=Beta, so the tau of a new vertex is proposed relative to its
+*  neighbour on a G line, from the |G| profile of the line; rebuilt whenever G changes
+*/
+void Markov::_BuildTauTable()
+{
+    TauTable.resize(SPIN * NSublat * NSublat);
+    vector<real> profile(MaxTauBin);
+    for (int s = 0; s < SPIN; s++)
+        for (int in = 0; in < NSublat; in++)
+            for (int out = 0; out < NSublat; out++) {
+                G->TauProfile(spin(s), in, out, profile.data());
+                real sum = 0.0;
+                for (auto p : profile)
+                    sum += p;
+                for (auto& p : profile)
+                    p = TauUniformShare / MaxTauBin + (sum > 0.0 ? (1.0 - TauUniformShare) * p / sum : 0.0);
+                TauTable[(s * NSublat + in) * NSublat + out].Build(profile);
+            }
+}
+
+/**
+*  W vanishes beyond a few neighbours for short-range models, so the site of a vertex is proposed
+*  relative to the other end of its W line, over all NSublat*Vol (sublattice, coordinate) pairs;
+*  rebuilt whenever W changes
+*/
+void Markov::_BuildSiteTable()
+{
+    int Vol = Lat->Vol;
+    SiteTable.resize(2 * NSublat);
+    vector<real> profile(Vol), weight(NSublat * Vol);
+    for (int dir = 0; dir < 2; dir++)
+        for (int partner = 0; partner < NSublat; partner++) {
+            real sum = 0.0;
+            for (int sub = 0; sub < NSublat; sub++) {
+                //the new vertex is the OUT end of the line if dir==OUT
+                if (dir == OUT)
+                    W->SpaceProfile(partner, sub, profile.data());
+                else
+                    W->SpaceProfile(sub, partner, profile.data());
+                for (int r = 0; r < Vol; r++) {
+                    weight[sub * Vol + r] = profile[r];
+                    sum += profile[r];
+                }
+            }
+            for (auto& w : weight)
+                w = SiteUniformShare / (NSublat * Vol) + (sum > 0.0 ? (1.0 - SiteUniformShare) * w / sum : 0.0);
+            SiteTable[dir * NSublat + partner].Build(weight);
+        }
 }
 
 std::string Markov::_DetailBalanceStr(Operations op)
 {
     string Output = OperationName[op] + ":\n";
-    char temp[80];
-    real TotalProposed = 0.0, TotalAccepted = 0.0;
+    char temp[160];
+    real TotalProposed = 0.0, TotalAccepted = 0.0, TotalCycles = 0.0;
     for (int i = 0; i <= Order; i++) {
         if (!Equal(Proposed[op][i], 0.0)) {
             TotalAccepted += Accepted[op][i];
             TotalProposed += Proposed[op][i];
-            sprintf(temp, "\t%8s%2i:%15g%15g%15g\n", "Order", i, Proposed[op][i], Accepted[op][i], Accepted[op][i] / Proposed[op][i]);
-            Output += temp;
+            TotalCycles += Cycles[op][i];
+            sprintf(temp, "\t%8s%2i:%15g%15g%15g", "Order", i, Proposed[op][i], Accepted[op][i], Accepted[op][i] / Proposed[op][i]);
+            Output += temp + _CostStr(Cycles[op][i], Proposed[op][i]);
         }
     }
     if (!Equal(TotalProposed, 0.0)) {
-        sprintf(temp, "\t%10s:%15g%15g%15g\n", "Summation", TotalProposed, TotalAccepted, TotalAccepted / TotalProposed);
-        Output += temp;
+        sprintf(temp, "\t%10s:%15g%15g%15g", "Summation", TotalProposed, TotalAccepted, TotalAccepted / TotalProposed);
+        Output += temp + _CostStr(TotalCycles, TotalProposed);
     }
     else
         Output += "\tNone\n";
+    return Output + _RejectionStr(op);
+}
+
+/**
+*  histogram of the reasons why op returned before its Metropolis step, order by order
+*/
+std::string Markov::_RejectionStr(Operations op)
+{
+    string Output = "";
+    for (int i = 0; i <= Order; i++) {
+        string Reasons = "";
+        for (int r = 0; r < NRejections; r++)
+            if (!Equal(Rejected[op][r][i], 0.0))
+                Reasons += " " + RejectionName[r] + ":" + ToString(Rejected[op][r][i]);
+        if (Reasons != "")
+            Output += "\t Rejected" + ToString(i) + ":" + Reasons + "\n";
+    }
     return Output;
 }
 
+/**
+*  cycles/proposal and % of Hop time columns of the detail balance table, empty unless PROFILE_UPDATES is defined
+*/
+std::string Markov::_CostStr(real cycles, real proposed)
+{
+#ifdef PROFILE_UPDATES
+    char temp[80];
+    sprintf(temp, "%15g%14.2f%%\n", cycles / proposed, Equal(HopCycles, 0.0) ? 0.0 : 100.0 * cycles / HopCycles);
+    return temp;
+#else
+    return "\n";
+#endif
+}
+
 std::string Markov::_CheckBalance(Operations op1, Operations op2)
 {
     string Output = OperationName[op1] + "<------>" + OperationName[op2] + ":\n";
@@ -167,6 +316,11 @@ void Markov::PrintDetailBalanceInfo()
     string Output = "";
     Output = string(60, '=') + "\n";
     Output += "DiagCounter: " + ToString(*Counter) + "\n";
+#ifdef PROFILE_UPDATES
+    char temp[160];
+    sprintf(temp, "\t%10s:%15s%15s%15s%15s%15s\n", "", "Proposed", "Accepted", "Ratio", "cycles/prop.", "% of Hop");
+    Output += temp;
+#endif
     Output += _DetailBalanceStr(CREATE_WORM);
     Output += _DetailBalanceStr(DELETE_WORM);
     Output += _DetailBalanceStr(MOVE_WORM_G);
@@ -197,6 +351,125 @@ void Markov::PrintDetailBalanceInfo()
     LOG_INFO(Output);
 }
 
+/**
+*  Sector of a configuration, every sector has its own table of update probabilities
+*/
+int Markov::_Sector(bool IsWorm, int order, bool IsMeasureG)
+{
+    if (IsWorm)
+        return IsMeasureG ? WORM_G : WORM_W;
+    else if (order == 0)
+        return IsMeasureG ? PHY_ORDER0_G : PHY_ORDER0_W;
+    else
+        return IsMeasureG ? PHY_G : PHY_W;
+}
+
+int Markov::_Sector()
+{
+    return _Sector(Worm->Exist, Diag->Order, Diag->MeasureGLine);
+}
+
+/**
+*  whether an update can ever be accepted in a sector; the others always return immediately,
+*  so they are never picked there
+*/
+bool Markov::_IsPossible(Operations op, int sector)
+{
+    bool IsWorm = (sector == WORM_G || sector == WORM_W);
+    bool IsOrder0 = (sector == PHY_ORDER0_G || sector == PHY_ORDER0_W);
+    bool IsMeasureG = (sector == PHY_ORDER0_G || sector == PHY_G || sector == WORM_G);
+    switch (op) {
+    case DELETE_WORM:
+    case MOVE_WORM_G:
+    case MOVE_WORM_W:
+    case RECONNECT:
+    case ADD_INTERACTION:
+    case DEL_INTERACTION:
+    case ADD_DELTA_INTERACTION:
+    case DEL_DELTA_INTERACTION:
+        return IsWorm;
+    case JUMP_BACK_TO_ORDER1:
+        return IsOrder0;
+    case CHANGE_MEASURE_G2W:
+        return !IsWorm && !IsOrder0 && IsMeasureG;
+    case CHANGE_MEASURE_W2G:
+        return !IsWorm && !IsOrder0 && !IsMeasureG;
+    case END:
+        return false;
+    default:
+        return !IsWorm && !IsOrder0;
+    }
+}
+
+/**
+*  Build the alias table of every sector from UpdateWeight.
+*  The acceptance ratio of an update always uses ProbofCall of the sector it starts from,
+*  and ProbofCall of the sector the inverse update starts from.
+*/
+void Markov::_BuildUpdateTable()
+{
+    for (int sector = 0; sector < NSectors; sector++) {
+        real weight[NUpdates];
+        for (int op = 0; op < NUpdates; op++)
+            weight[op] = (op < END && _IsPossible(Operations(op), sector)) ? UpdateWeight[op] : 0.0;
+        UpdateTable[sector].Build(weight, NUpdates);
+        for (int op = 0; op < NUpdates; op++)
+            ProbofCall[sector][op] = UpdateTable[sector].Prob(op);
+    }
+}
+
+/**
+*  Rebalance UpdateWeight with the acceptance ratios measured so far, an update and its inverse
+*  are tuned together. Only call it during thermalization: once a pair is tuned, the table is frozen
+*  and saved in ParaMC::UpdateWeight, so detailed balance is exact in production and restarts reuse it.
+*/
+void Markov::TuneUpdateWeight()
+{
+    if (!FrozenUpdateWeight->empty())
+        return;
+    const Operations Pairs[][2] = {
+        { CREATE_WORM, DELETE_WORM },
+        { MOVE_WORM_G, MOVE_WORM_G },
+        { MOVE_WORM_W, MOVE_WORM_W },
+        { RECONNECT, RECONNECT },
+        { ADD_INTERACTION, DEL_INTERACTION },
+        { ADD_DELTA_INTERACTION, DEL_DELTA_INTERACTION },
+        { CHANGE_TAU_VERTEX, CHANGE_TAU_VERTEX },
+        { CHANGE_R_VERTEX, CHANGE_R_VERTEX },
+        { CHANGE_R_LOOP, CHANGE_R_LOOP },
+        { CHANGE_MEASURE_G2W, CHANGE_MEASURE_W2G },
+        { CHANGE_DELTA2CONTINUS, CHANGE_CONTINUS2DELTA },
+        { CHANGE_SPIN_VERTEX, CHANGE_SPIN_VERTEX },
+        { JUMP_TO_ORDER0, JUMP_BACK_TO_ORDER1 }
+    };
+    bool Tuned = false;
+    for (auto& pair : Pairs) {
+        real proposed = 0.0, accepted = 0.0;
+        for (int i = 0; i <= Order; i++) {
+            proposed += Proposed[pair[0]][i] + (pair[1] != pair[0] ? Proposed[pair[1]][i] : 0.0);
+            accepted += Accepted[pair[0]][i] + (pair[1] != pair[0] ? Accepted[pair[1]][i] : 0.0);
+        }
+        if (proposed < MinProposedToTune)
+            continue;
+        real weight = min(1.0, max(MinUpdateWeight, accepted / proposed / TargetAcceptRatio));
+        for (auto op : pair)
+            if (UpdateWeight[op] > 0.0)
+                UpdateWeight[op] = weight;
+        Tuned = true;
+    }
+    //too few proposals to tune anything, keep the table open for a later call
+    if (!Tuned) {
+        LOG_INFO("Too few updates are proposed to tune the update weights!");
+        return;
+    }
+    _BuildUpdateTable();
+    FrozenUpdateWeight->assign(UpdateWeight, UpdateWeight + NUpdates);
+    string Output = "Update weights are tuned to:\n";
+    for (int op = 0; op < END; op++)
+        Output += "\t" + OperationName[op] + ": " + ToString(UpdateWeight[op]) + "\n";
+    LOG_INFO(Output);
+}
+
 /**
 *  \brief let the Grasshopper hops for Steps
 *
@@ -204,68 +477,130 @@ void Markov::PrintDetailBalanceInfo()
 */
 void Markov::Hop(int sweep)
 {
+#ifdef PROFILE_UPDATES
+    unsigned long long HopStart = ReadCycles();
+#endif
     for (int i = 0; i < sweep; i++) {
-        double x = RNG->urn();
-        if (x < SumofProbofCall[CREATE_WORM])
+        int sector = _Sector();
+        int order = Diag->Order;
+        int op = UpdateTable[sector].Sample(*RNG);
+        bool timed = CostTiming && ((*Counter & (CostSampling - 1)) == 0);
+        unsigned long long costStart = timed ? ReadCycles() : 0;
+#ifdef PROFILE_UPDATES
+        unsigned long long start = ReadCycles();
+#endif
+        switch (op) {
+        case CREATE_WORM:
             CreateWorm();
-        //            ;
-        else if (x < SumofProbofCall[DELETE_WORM])
+            break;
+        case DELETE_WORM:
             DeleteWorm();
-        //            ;
-        else if (x < SumofProbofCall[MOVE_WORM_G])
+            break;
+        case MOVE_WORM_G:
             MoveWormOnG();
-        //            ;
-        else if (x < SumofProbofCall[MOVE_WORM_W])
+            break;
+        case MOVE_WORM_W:
             MoveWormOnW();
-        //            ;
-        else if (x < SumofProbofCall[RECONNECT])
+            break;
+        case RECONNECT:
             Reconnect();
-        //            ;
-        else if (x < SumofProbofCall[ADD_INTERACTION])
+            break;
+        case ADD_INTERACTION:
             AddInteraction();
-        //            ;
-        else if (x < SumofProbofCall[DEL_INTERACTION])
+            break;
+        case DEL_INTERACTION:
             DeleteInteraction();
-        //            ;
-        else if (x < SumofProbofCall[ADD_DELTA_INTERACTION])
+            break;
+        case ADD_DELTA_INTERACTION:
             AddDeltaInteraction();
-        //            ;
-        else if (x < SumofProbofCall[DEL_DELTA_INTERACTION])
+            break;
+        case DEL_DELTA_INTERACTION:
             DeleteDeltaInteraction();
-        //            ;
-        else if (x < SumofProbofCall[CHANGE_TAU_VERTEX])
+            break;
+        case CHANGE_TAU_VERTEX:
             ChangeTauOnVertex();
-        //            ;
-        else if (x < SumofProbofCall[CHANGE_R_VERTEX])
-            ;
-        //                    ChangeROnVertex();
-        else if (x < SumofProbofCall[CHANGE_R_LOOP])
+            break;
+        case CHANGE_R_VERTEX:
+            ChangeROnVertex();
+            break;
+        case CHANGE_R_LOOP:
             ChangeRLoop();
-        //            ;
-        else if (x < SumofProbofCall[CHANGE_MEASURE_G2W])
+            break;
+        case CHANGE_MEASURE_G2W:
             ChangeMeasureFromGToW();
-        //            ;
-        else if (x < SumofProbofCall[CHANGE_MEASURE_W2G])
+            break;
+        case CHANGE_MEASURE_W2G:
             ChangeMeasureFromWToG();
-        //            ;
-        else if (x < SumofProbofCall[CHANGE_DELTA2CONTINUS])
+            break;
+        case CHANGE_DELTA2CONTINUS:
             ChangeDeltaToContinuous();
-        //            ;
-        else if (x < SumofProbofCall[CHANGE_CONTINUS2DELTA])
+            break;
+        case CHANGE_CONTINUS2DELTA:
             ChangeContinuousToDelta();
-        //            ;
-        else if (x < SumofProbofCall[CHANGE_SPIN_VERTEX])
-            ;
-        //            ChangeSpinOnVertex();
-        else if (x < SumofProbofCall[JUMP_TO_ORDER0])
+            break;
+        case CHANGE_SPIN_VERTEX:
+            ChangeSpinOnVertex();
+            break;
+        case JUMP_TO_ORDER0:
             JumpToOrder0();
-        //        ;
-        else if (x < SumofProbofCall[JUMP_BACK_TO_ORDER1])
+            break;
+        case JUMP_BACK_TO_ORDER1:
             JumpBackToOrder1();
-        //        ;
+            break;
+        }
+#ifdef PROFILE_UPDATES
+        Cycles[op][order] += ReadCycles() - start;
+#endif
+        if (timed) {
+            SectorCycles[sector][order] += ReadCycles() - costStart;
+            SectorSteps[sector][order] += 1.0;
+        }
 
         (*Counter)++;
     }
+#ifdef PROFILE_UPDATES
+    HopCycles += ReadCycles() - HopStart;
+#endif
+}
+
+void Markov::ClearCost()
+{
+    InitialArray(&SectorCycles[0][0], 0.0, NSectors * MAX_ORDER);
+    InitialArray(&SectorSteps[0][0], 0.0, NSectors * MAX_ORDER);
+}
+
+/**
+*  Early rejections of each update, {operation: {reason: [count of each order]}}
+*/
+Dictionary Markov::RejectionToDict()
+{
+    Dictionary dict;
+    for (int op = 0; op < END; op++) {
+        Dictionary reasons;
+        for (int r = 0; r < NRejections; r++)
+            reasons[RejectionName[r]] = vector<real>(Rejected[op][r], Rejected[op][r] + Order + 1);
+        dict[OperationName[op]] = reasons;
+    }
+    return dict;
+}
+
+/**
+*  Cycles spent in each update and order, and the proposals they made, empty unless PROFILE_UPDATES is defined
+*/
+Dictionary Markov::UpdateCostToDict()
+{
+    Dictionary dict;
+#ifdef PROFILE_UPDATES
+    Dictionary cycles, proposed;
+    for (int op = 0; op < END; op++) {
+        cycles[OperationName[op]] = vector<real>(Cycles[op], Cycles[op] + Order + 1);
+        proposed[OperationName[op]] = vector<real>(Proposed[op], Proposed[op] + Order + 1);
+    }
+    dict["Cycles"] = cycles;
+    dict["Proposed"] = proposed;
+    dict["HopCycles"] = HopCycles;
+#endif
+    return dict;
 }
 
 /**
@@ -274,7 +609,7 @@ void Markov::Hop(int sweep)
 void Markov::CreateWorm()
 {
     if (Diag->Order == 0 || Worm->Exist)
-        return;
+        return _Reject(CREATE_WORM, WRONG_SECTOR);
 
     wLine w = Diag->W.RandomPick(*RNG);
     vertex vin = w->NeighVer(IN);
@@ -283,24 +618,24 @@ void Markov::CreateWorm()
     Momentum kWorm = RandomPickK();
     Momentum kW = w->K - kWorm;
     if (Diag->WHashCheck(kW))
-        return;
+        return _Reject(CREATE_WORM, HASH_COLLISION);
 
     int dspin = RandomPickDeltaSpin();
     if (CanNotMoveWorm(dspin, vin->Spin(IN), vin->Spin(OUT)) && CanNotMoveWorm(-dspin, vout->Spin(IN), vout->Spin(OUT)))
-        return;
+        return _Reject(CREATE_WORM, SPIN_CONFLICT);
 
-    Complex wWeight = W->Weight(vin->R, vout->R, vin->Tau, vout->Tau,
+    Amplitude wWeight = W->Weight(vin->R, vout->R, vin->Tau, vout->Tau,
                                 vin->Spin(), vout->Spin(),
                                 true, //IsWorm
                                 w->IsMeasure, w->IsDelta);
 
-    Complex weightRatio = wWeight / w->Weight;
+    Amplitude weightRatio = wWeight / w->Weight;
     real prob = mod(weightRatio);
-    Complex sgn = phase(weightRatio);
+    Amplitude sgn = phase(weightRatio);
 
     real wormWeight = weight::Worm::Weight(vin->R, vout->R, vin->Tau, vout->Tau);
 
-    prob *= ProbofCall[DELETE_WORM] / ProbofCall[CREATE_WORM] * (*WormSpaceReweight) * wormWeight * Diag->Order * 2.0;
+    prob *= ProbofCall[_Sector(true, Diag->Order, Diag->MeasureGLine)][DELETE_WORM] / ProbofCall[_Sector()][CREATE_WORM] * (*WormSpaceReweight) * wormWeight * Diag->Order * 2.0;
 
     Proposed[CREATE_WORM][Diag->Order] += 1.0;
     if (prob >= 1.0 || RNG->urn() < prob) {
@@ -328,27 +663,27 @@ void Markov::CreateWorm()
 void Markov::DeleteWorm()
 {
     if (Diag->Order == 0 || !Worm->Exist)
-        return;
+        return _Reject(DELETE_WORM, WRONG_SECTOR);
     vertex &Ira = Worm->Ira;
     vertex &Masha = Worm->Masha;
 
     wLine w = Ira->NeighW();
     if (!(w == Masha->NeighW()))
-        return;
+        return _Reject(DELETE_WORM, TOPOLOGY);
     Momentum k = w->K + SIGN(Ira->Dir) * Worm->K;
     if (Diag->WHashCheck(k))
-        return;
+        return _Reject(DELETE_WORM, HASH_COLLISION);
 
-    Complex wWeight = W->Weight(Ira->Dir, Ira->R, Masha->R, Ira->Tau, Masha->Tau,
+    Amplitude wWeight = W->Weight(Ira->Dir, Ira->R, Masha->R, Ira->Tau, Masha->Tau,
                                 Ira->Spin(), Masha->Spin(),
                                 false, //IsWorm
                                 w->IsMeasure, w->IsDelta);
 
-    Complex weightRatio = wWeight / w->Weight;
+    Amplitude weightRatio = wWeight / w->Weight;
     real prob = mod(weightRatio);
-    Complex sgn = phase(weightRatio);
+    Amplitude sgn = phase(weightRatio);
 
-    prob *= ProbofCall[CREATE_WORM] / (ProbofCall[DELETE_WORM] * (*WormSpaceReweight) * Worm->Weight * Diag->Order * 2.0);
+    prob *= ProbofCall[_Sector(false, Diag->Order, Diag->MeasureGLine)][CREATE_WORM] / (ProbofCall[_Sector()][DELETE_WORM] * (*WormSpaceReweight) * Worm->Weight * Diag->Order * 2.0);
 
     Proposed[DELETE_WORM][Diag->Order] += 1.0;
     if (prob >= 1.0 || RNG->urn() < prob) {
@@ -371,7 +706,7 @@ void Markov::DeleteWorm()
 void Markov::MoveWormOnG()
 {
     if (Diag->Order == 0 || !Worm->Exist)
-        return;
+        return _Reject(MOVE_WORM_G, WRONG_SECTOR);
 
     vertex &Ira = Worm->Ira;
     vertex &Masha = Worm->Masha;
@@ -380,11 +715,13 @@ void Markov::MoveWormOnG()
     gLine g = Ira->NeighG(dir);
     vertex v2 = g->NeighVer(dir);
 
-    if (v2 == Ira || v2 == Masha || CanNotMoveWorm(Worm->dSpin, g->Spin(), dir))
-        return;
+    if (v2 == Ira || v2 == Masha)
+        return _Reject(MOVE_WORM_G, TOPOLOGY);
+    if (CanNotMoveWorm(Worm->dSpin, g->Spin(), dir))
+        return _Reject(MOVE_WORM_G, SPIN_CONFLICT);
     Momentum k = g->K - SIGN(dir) * Worm->K;
     if (Diag->GHashCheck(k))
-        return;
+        return _Reject(MOVE_WORM_G, HASH_COLLISION);
 
     wLine w1 = Ira->NeighW();
     vertex vW1 = w1->NeighVer(INVERSE(Ira->Dir));
@@ -394,36 +731,45 @@ void Markov::MoveWormOnG()
     else
         isWormW1 = Diag->IsWorm(vW1);
 
+    wLine w2 = v2->NeighW();
+    vertex vW2 = w2->NeighVer(INVERSE(v2->Dir));
+
+    real wormWeight = weight::Worm::Weight(v2->R, Masha->R, v2->Tau, Masha->Tau);
+
+    Proposed[MOVE_WORM_G][Diag->Order] += 1.0;
+    real u = RNG->urn();
+    real bound = GMaxWeight * WMaxWeight * WMaxWeight * wormWeight / (Worm->Weight * mod(g->Weight * w1->Weight * w2->Weight));
+    if (u >= bound)
+        return _Reject(MOVE_WORM_G, WEIGHT_BOUND);
+
     spin spinV1[2] = {Ira->Spin(0), Ira->Spin(1)};
     spinV1[dir] = FLIP(spinV1[dir]);
 
-    Complex w1Weight = W->Weight(Ira->Dir, Ira->R, vW1->R, Ira->Tau, vW1->Tau,
+    Amplitude w1Weight = W->Weight(Ira->Dir, Ira->R, vW1->R, Ira->Tau, vW1->Tau,
                                  spinV1, vW1->Spin(), isWormW1, w1->IsMeasure, w1->IsDelta);
-
-    wLine w2 = v2->NeighW();
-    vertex vW2 = w2->NeighVer(INVERSE(v2->Dir));
+    if (RejectEarly(u, bound, w1Weight, WMaxWeight))
+        return _Reject(MOVE_WORM_G, WEIGHT_BOUND);
 
     spin spinV2[2] = {v2->Spin(0), v2->Spin(1)};
     spinV2[INVERSE(dir)] = FLIP(spinV2[INVERSE(dir)]);
 
-    Complex w2Weight = W->Weight(v2->Dir, v2->R, vW2->R, v2->Tau, vW2->Tau,
+    Amplitude w2Weight = W->Weight(v2->Dir, v2->R, vW2->R, v2->Tau, vW2->Tau,
                                  spinV2, vW2->Spin(),
                                  true, //IsWorm
                                  w2->IsMeasure, w2->IsDelta);
+    if (RejectEarly(u, bound, w2Weight, WMaxWeight))
+        return _Reject(MOVE_WORM_G, WEIGHT_BOUND);
 
-    Complex gWeight = G->Weight(INVERSE(dir), Ira->R, v2->R, Ira->Tau, v2->Tau,
+    Amplitude gWeight = G->Weight(INVERSE(dir), Ira->R, v2->R, Ira->Tau, v2->Tau,
                                 spinV1[dir], spinV2[INVERSE(dir)], g->IsMeasure);
 
-    Complex weightRatio = w1Weight * w2Weight * gWeight / (g->Weight * w1->Weight * w2->Weight);
+    Amplitude weightRatio = w1Weight * w2Weight * gWeight / (g->Weight * w1->Weight * w2->Weight);
     real prob = mod(weightRatio);
-    Complex sgn = phase(weightRatio);
-
-    real wormWeight = weight::Worm::Weight(v2->R, Masha->R, v2->Tau, Masha->Tau);
+    Amplitude sgn = phase(weightRatio);
 
     prob *= wormWeight / Worm->Weight;
 
-    Proposed[MOVE_WORM_G][Diag->Order] += 1.0;
-    if (prob >= 1.0 || RNG->urn() < prob) {
+    if (u < prob) {
         Accepted[MOVE_WORM_G][Diag->Order] += 1.0;
         Diag->Phase *= sgn;
         Diag->Weight *= weightRatio;
@@ -452,7 +798,7 @@ void Markov::MoveWormOnG()
 void Markov::MoveWormOnW()
 {
     if (Diag->Order == 0 || !Worm->Exist)
-        return;
+        return _Reject(MOVE_WORM_W, WRONG_SECTOR);
 
     vertex &Ira = Worm->Ira;
     vertex &Masha = Worm->Masha;
@@ -460,17 +806,17 @@ void Markov::MoveWormOnW()
     wLine w = Ira->NeighW();
     vertex v2 = w->NeighVer(INVERSE(Ira->Dir));
     if (v2 == Ira || v2 == Masha)
-        return;
+        return _Reject(MOVE_WORM_W, TOPOLOGY);
     Momentum k = w->K + SIGN(Ira->Dir) * Worm->K;
     if (Diag->WHashCheck(k))
-        return;
+        return _Reject(MOVE_WORM_W, HASH_COLLISION);
 
-    Complex wWeight = W->Weight(Ira->Dir, Ira->R, v2->R, Ira->Tau, v2->Tau, Ira->Spin(),
+    Amplitude wWeight = W->Weight(Ira->Dir, Ira->R, v2->R, Ira->Tau, v2->Tau, Ira->Spin(),
                                 v2->Spin(), w->IsWorm, w->IsMeasure, w->IsDelta);
 
-    Complex weightRatio = wWeight / w->Weight;
+    Amplitude weightRatio = wWeight / w->Weight;
     real prob = mod(weightRatio);
-    Complex sgn = phase(weightRatio);
+    Amplitude sgn = phase(weightRatio);
 
     real wormWeight = weight::Worm::Weight(v2->R, Masha->R, v2->Tau, Masha->Tau);
     prob *= wormWeight / Worm->Weight;
@@ -496,32 +842,32 @@ void Markov::MoveWormOnW()
 void Markov::Reconnect()
 {
     if (Diag->Order == 0 || !Worm->Exist)
-        return;
+        return _Reject(RECONNECT, WRONG_SECTOR);
 
     vertex Ira = Worm->Ira;
     vertex Masha = Worm->Masha;
 
     if (!(Ira->R == Masha->R))
-        return;
+        return _Reject(RECONNECT, SITE_MISMATCH);
     int dir = RandomPickDir();
     gLine GIA = Ira->NeighG(dir);
     gLine GMB = Masha->NeighG(dir);
     if (GIA->Spin() != GMB->Spin())
-        return;
+        return _Reject(RECONNECT, SPIN_CONFLICT);
 
     Momentum k = Worm->K + SIGN(dir) * (GMB->K - GIA->K);
 
     vertex vA = GIA->NeighVer(dir);
-    Complex GIAWeight = G->Weight(INVERSE(dir), Masha->R, vA->R, Masha->Tau, vA->Tau,
+    Amplitude GIAWeight = G->Weight(INVERSE(dir), Masha->R, vA->R, Masha->Tau, vA->Tau,
                                   Masha->Spin(dir), vA->Spin(INVERSE(dir)), GIA->IsMeasure);
 
     vertex vB = GMB->NeighVer(dir);
-    Complex GMBWeight = G->Weight(INVERSE(dir), Ira->R, vB->R, Ira->Tau, vB->Tau,
+    Amplitude GMBWeight = G->Weight(INVERSE(dir), Ira->R, vB->R, Ira->Tau, vB->Tau,
                                   Ira->Spin(dir), vB->Spin(INVERSE(dir)), GMB->IsMeasure);
 
-    Complex weightRatio = (-1) * GIAWeight * GMBWeight / (GIA->Weight * GMB->Weight);
+    Amplitude weightRatio = (-1) * GIAWeight * GMBWeight / (GIA->Weight * GMB->Weight);
     real prob = mod(weightRatio);
-    Complex sgn = phase(weightRatio);
+    Amplitude sgn = phase(weightRatio);
 
     Proposed[RECONNECT][Diag->Order] += 1.0;
     if (prob >= 1.0 || RNG->urn() < prob) {
@@ -551,14 +897,14 @@ void Markov::Reconnect()
 void Markov::AddInteraction()
 {
     if (!Worm->Exist)
-        return;
+        return _Reject(ADD_INTERACTION, WRONG_SECTOR);
     if (Diag->Order == 0 || Diag->Order >= Order)
-        return;
+        return _Reject(ADD_INTERACTION, WRONG_SECTOR);
     vertex Ira = Worm->Ira, Masha = Worm->Masha;
 
     Momentum kW = RandomPickK();
     if (Diag->WHashCheck(kW))
-        return;
+        return _Reject(ADD_INTERACTION, HASH_COLLISION);
 
     int dir = RandomPickDir();
     int dirW = RandomPickDir();
@@ -568,47 +914,62 @@ void Markov::AddInteraction()
     Momentum kMB = GMD->K + SIGN(dir) * SIGN(dirW) * kW;
     Momentum kWorm = Worm->K - SIGN(dirW) * kW;
     if (Diag->GHashCheck(kIA))
-        return;
+        return _Reject(ADD_INTERACTION, HASH_COLLISION);
     if (Diag->GHashCheck(kMB))
-        return;
+        return _Reject(ADD_INTERACTION, HASH_COLLISION);
     if (kIA == kMB)
-        return;
+        return _Reject(ADD_INTERACTION, HASH_COLLISION);
+    if (!W->IsInRange(GIC->NeighVer(dir)->R, GMD->NeighVer(dir)->R))
+        return _Reject(ADD_INTERACTION, OUT_OF_RANGE);
 
-    real tauA = RandomPickTau(), tauB = RandomPickTau();
+    //A and B are sampled relative to Ira and Masha, on the sites of C and D
+    int subA = GIC->NeighVer(dir)->R.Sublattice, subB = GMD->NeighVer(dir)->R.Sublattice;
+    real tauA = RandomPickTau(Ira->Tau, dir, GIC->Spin(), Ira->R.Sublattice, subA);
+    real tauB = RandomPickTau(Masha->Tau, dir, GMD->Spin(), Masha->R.Sublattice, subB);
+
+    real probFactor = OrderReWeight[Diag->Order + 1] * ProbofCall[_Sector()][DEL_INTERACTION] / (ProbofCall[_Sector()][ADD_INTERACTION] * OrderReWeight[Diag->Order] * ProbTau(tauA, Ira->Tau, dir, GIC->Spin(), Ira->R.Sublattice, subA) * ProbTau(tauB, Masha->Tau, dir, GMD->Spin(), Masha->R.Sublattice, subB));
+
+    Proposed[ADD_INTERACTION][Diag->Order] += 1.0;
+    real u = RNG->urn();
+    real bound = probFactor * pow(GMaxWeight, 4) * WMaxWeight / mod(GIC->Weight * GMD->Weight);
+    if (u >= bound)
+        return _Reject(ADD_INTERACTION, WEIGHT_BOUND);
 
     spin spinA[2] = {GIC->Spin(), GIC->Spin()};
     spin spinB[2] = {GMD->Spin(), GMD->Spin()};
     vertex vC = GIC->NeighVer(dir), vD = GMD->NeighVer(dir);
     Site RA = vC->R, RB = vD->R;
 
-    Complex wWeight = W->Weight(dirW, RA, RB, tauA, tauB, spinA, spinB,
-                                false,  //IsWorm
-                                false,  //IsMeasure
-                                false); //IsDelta
+    Amplitude wWeight = W->Weight<false, false, false>(dirW, RA, RB, tauA, tauB, spinA, spinB);
+    if (RejectEarly(u, bound, wWeight, WMaxWeight))
+        return _Reject(ADD_INTERACTION, WEIGHT_BOUND);
 
-    Complex GIAWeight = G->Weight(INVERSE(dir), Ira->R, RA, Ira->Tau, tauA,
-                                  Ira->Spin(dir), spinA[INVERSE(dir)],
-                                  false); //IsMeasure
+    Amplitude GIAWeight = G->Weight<false>(INVERSE(dir), Ira->R, RA, Ira->Tau, tauA,
+                                         Ira->Spin(dir), spinA[INVERSE(dir)]);
+    if (RejectEarly(u, bound, GIAWeight, GMaxWeight))
+        return _Reject(ADD_INTERACTION, WEIGHT_BOUND);
 
-    Complex GMBWeight = G->Weight(INVERSE(dir), Masha->R, RB, Masha->Tau, tauB,
-                                  Masha->Spin(dir), spinB[INVERSE(dir)],
-                                  false); //IsMeasure
+    Amplitude GMBWeight = G->Weight<false>(INVERSE(dir), Masha->R, RB, Masha->Tau, tauB,
+                                         Masha->Spin(dir), spinB[INVERSE(dir)]);
+    if (RejectEarly(u, bound, GMBWeight, GMaxWeight))
+        return _Reject(ADD_INTERACTION, WEIGHT_BOUND);
 
-    Complex GACWeight = G->Weight(INVERSE(dir), RA, vC->R, tauA, vC->Tau,
+    Amplitude GACWeight = G->Weight(INVERSE(dir), RA, vC->R, tauA, vC->Tau,
                                   spinA[dir], vC->Spin(INVERSE(dir)), GIC->IsMeasure);
+    if (RejectEarly(u, bound, GACWeight, GMaxWeight))
+        return _Reject(ADD_INTERACTION, WEIGHT_BOUND);
 
-    Complex GBDWeight = G->Weight(INVERSE(dir), RB, vD->R, tauB, vD->Tau,
+    Amplitude GBDWeight = G->Weight(INVERSE(dir), RB, vD->R, tauB, vD->Tau,
                                   spinB[dir], vD->Spin(INVERSE(dir)), GMD->IsMeasure);
 
-    Complex weightRatio = (-1) * GIAWeight * GMBWeight * wWeight * GACWeight * GBDWeight / (GIC->Weight * GMD->Weight);
+    Amplitude weightRatio = (-1) * GIAWeight * GMBWeight * wWeight * GACWeight * GBDWeight / (GIC->Weight * GMD->Weight);
 
     real prob = mod(weightRatio);
-    Complex sgn = phase(weightRatio);
+    Amplitude sgn = phase(weightRatio);
 
-    prob *= OrderReWeight[Diag->Order + 1] * ProbofCall[DEL_INTERACTION] / (ProbofCall[ADD_INTERACTION] * OrderReWeight[Diag->Order] * ProbTau(tauA) * ProbTau(tauB));
+    prob *= probFactor;
 
-    Proposed[ADD_INTERACTION][Diag->Order] += 1.0;
-    if (prob >= 1.0 || RNG->urn() < prob) {
+    if (u < prob) {
         Accepted[ADD_INTERACTION][Diag->Order] += 1.0;
         Diag->Order += 1;
         Diag->Phase *= sgn;
@@ -671,59 +1032,69 @@ void Markov::AddInteraction()
 void Markov::DeleteInteraction()
 {
     if (!Worm->Exist)
-        return;
+        return _Reject(DEL_INTERACTION, WRONG_SECTOR);
     if (Diag->Order <= 1)
-        return;
+        return _Reject(DEL_INTERACTION, WRONG_SECTOR);
     vertex Ira = Worm->Ira, Masha = Worm->Masha;
 
     int dir = RandomPickDir();
     gLine GIA = Ira->NeighG(dir), GMB = Masha->NeighG(dir);
     if (GIA->IsMeasure)
-        return;
+        return _Reject(DEL_INTERACTION, MEASURE_LINE);
     if (GMB->IsMeasure)
-        return;
+        return _Reject(DEL_INTERACTION, MEASURE_LINE);
 
     vertex vA = GIA->NeighVer(dir), vB = GMB->NeighVer(dir);
     if (vA->Spin(IN) != vA->Spin(OUT))
-        return;
+        return _Reject(DEL_INTERACTION, SPIN_CONFLICT);
     if (vB->Spin(IN) != vB->Spin(OUT))
-        return;
+        return _Reject(DEL_INTERACTION, SPIN_CONFLICT);
 
     if (vA->NeighW() != vB->NeighW())
-        return;
+        return _Reject(DEL_INTERACTION, TOPOLOGY);
 
     wLine wAB = vA->NeighW();
     if (wAB->IsMeasure)
-        return;
+        return _Reject(DEL_INTERACTION, MEASURE_LINE);
     if (wAB->IsWorm)
-        return;
+        return _Reject(DEL_INTERACTION, WORM_LINE);
     if (wAB->IsDelta)
-        return;
+        return _Reject(DEL_INTERACTION, DELTA_LINE);
 
     gLine GAC = vA->NeighG(dir), GBD = vB->NeighG(dir);
     vertex vC = GAC->NeighVer(dir), vD = GBD->NeighVer(dir);
     if (vA->R != vC->R)
-        return;
+        return _Reject(DEL_INTERACTION, SITE_MISMATCH);
     if (vB->R != vD->R)
-        return;
+        return _Reject(DEL_INTERACTION, SITE_MISMATCH);
 
     Momentum kWorm = Worm->K + SIGN(vA->Dir) * wAB->K;
 
-    Complex GICWeight = G->Weight(INVERSE(dir), Ira->R, vC->R, Ira->Tau, vC->Tau,
+    real probFactor = OrderReWeight[Diag->Order - 1] * ProbofCall[_Sector()][ADD_INTERACTION] * ProbTau(vA->Tau, Ira->Tau, dir, GIA->Spin(), Ira->R.Sublattice, vA->R.Sublattice) * ProbTau(vB->Tau, Masha->Tau, dir, GMB->Spin(), Masha->R.Sublattice, vB->R.Sublattice) / (ProbofCall[_Sector()][DEL_INTERACTION] * OrderReWeight[Diag->Order]);
+
+    Proposed[DEL_INTERACTION][Diag->Order] += 1.0;
+    real u = RNG->urn();
+    Amplitude oldWeight = GIA->Weight * GMB->Weight * GAC->Weight * GBD->Weight * wAB->Weight;
+    real bound = probFactor * GMaxWeight * GMaxWeight / mod(oldWeight);
+    if (u >= bound)
+        return _Reject(DEL_INTERACTION, WEIGHT_BOUND);
+
+    Amplitude GICWeight = G->Weight(INVERSE(dir), Ira->R, vC->R, Ira->Tau, vC->Tau,
                                   Ira->Spin(dir), vC->Spin(INVERSE(dir)), GAC->IsMeasure);
+    if (RejectEarly(u, bound, GICWeight, GMaxWeight))
+        return _Reject(DEL_INTERACTION, WEIGHT_BOUND);
 
-    Complex GMDWeight = G->Weight(INVERSE(dir), Masha->R, vD->R, Masha->Tau, vD->Tau,
+    Amplitude GMDWeight = G->Weight(INVERSE(dir), Masha->R, vD->R, Masha->Tau, vD->Tau,
                                   Masha->Spin(dir), vD->Spin(INVERSE(dir)), GBD->IsMeasure);
 
-    Complex weightRatio = (-1) * GICWeight * GMDWeight / (GIA->Weight * GMB->Weight * GAC->Weight * GBD->Weight * wAB->Weight);
+    Amplitude weightRatio = (-1) * GICWeight * GMDWeight / oldWeight;
 
     real prob = mod(weightRatio);
-    Complex sgn = phase(weightRatio);
+    Amplitude sgn = phase(weightRatio);
 
-    prob *= OrderReWeight[Diag->Order - 1] * ProbofCall[ADD_INTERACTION] * ProbTau(vA->Tau) * ProbTau(vB->Tau) / (ProbofCall[DEL_INTERACTION] * OrderReWeight[Diag->Order]);
+    prob *= probFactor;
 
-    Proposed[DEL_INTERACTION][Diag->Order] += 1.0;
-    if (prob >= 1.0 || RNG->urn() < prob) {
+    if (u < prob) {
         Accepted[DEL_INTERACTION][Diag->Order] += 1.0;
 
         Diag->Order--;
@@ -762,14 +1133,14 @@ void Markov::DeleteInteraction()
 void Markov::AddDeltaInteraction()
 {
     if (!Worm->Exist)
-        return;
+        return _Reject(ADD_DELTA_INTERACTION, WRONG_SECTOR);
     if (Diag->Order == 0 || Diag->Order >= Order)
-        return;
+        return _Reject(ADD_DELTA_INTERACTION, WRONG_SECTOR);
     vertex Ira = Worm->Ira, Masha = Worm->Masha;
 
     Momentum kW = RandomPickK();
     if (Diag->WHashCheck(kW))
-        return;
+        return _Reject(ADD_DELTA_INTERACTION, HASH_COLLISION);
 
     int dir = RandomPickDir();
     int dirW = RandomPickDir();
@@ -779,47 +1150,61 @@ void Markov::AddDeltaInteraction()
     Momentum kMB = GMD->K + SIGN(dir) * SIGN(dirW) * kW;
     Momentum kWorm = Worm->K - SIGN(dirW) * kW;
     if (Diag->GHashCheck(kIA))
-        return;
+        return _Reject(ADD_DELTA_INTERACTION, HASH_COLLISION);
     if (Diag->GHashCheck(kMB))
-        return;
+        return _Reject(ADD_DELTA_INTERACTION, HASH_COLLISION);
     if (kIA == kMB)
-        return;
+        return _Reject(ADD_DELTA_INTERACTION, HASH_COLLISION);
+    if (!W->IsInRange(GIC->NeighVer(dir)->R, GMD->NeighVer(dir)->R))
+        return _Reject(ADD_DELTA_INTERACTION, OUT_OF_RANGE);
+
+    //A is sampled relative to Ira, on the site of C, and B shares its tau
+    int subA = GIC->NeighVer(dir)->R.Sublattice;
+    real tauA = RandomPickTau(Ira->Tau, dir, GIC->Spin(), Ira->R.Sublattice, subA);
 
-    real tauA = RandomPickTau();
+    real probFactor = OrderReWeight[Diag->Order + 1] * ProbofCall[_Sector()][DEL_DELTA_INTERACTION] / (ProbofCall[_Sector()][ADD_DELTA_INTERACTION] * OrderReWeight[Diag->Order] * ProbTau(tauA, Ira->Tau, dir, GIC->Spin(), Ira->R.Sublattice, subA));
+
+    Proposed[ADD_DELTA_INTERACTION][Diag->Order] += 1.0;
+    real u = RNG->urn();
+    real bound = probFactor * pow(GMaxWeight, 4) * WMaxWeight / mod(GIC->Weight * GMD->Weight);
+    if (u >= bound)
+        return _Reject(ADD_DELTA_INTERACTION, WEIGHT_BOUND);
 
     spin spinA[2] = {GIC->Spin(), GIC->Spin()};
     spin spinB[2] = {GMD->Spin(), GMD->Spin()};
     vertex vC = GIC->NeighVer(dir), vD = GMD->NeighVer(dir);
     Site RA = vC->R, RB = vD->R;
 
-    Complex wWeight = W->Weight(dirW, RA, RB, tauA, tauA, spinA, spinB,
-                                false, //IsWorm
-                                false, //IsMeasure
-                                true); //IsDelta
+    Amplitude wWeight = W->Weight<false, false, true>(dirW, RA, RB, tauA, tauA, spinA, spinB);
+    if (RejectEarly(u, bound, wWeight, WMaxWeight))
+        return _Reject(ADD_DELTA_INTERACTION, WEIGHT_BOUND);
 
-    Complex GIAWeight = G->Weight(INVERSE(dir), Ira->R, RA, Ira->Tau, tauA,
-                                  Ira->Spin(dir), spinA[INVERSE(dir)],
-                                  false); //IsMeasure
+    Amplitude GIAWeight = G->Weight<false>(INVERSE(dir), Ira->R, RA, Ira->Tau, tauA,
+                                         Ira->Spin(dir), spinA[INVERSE(dir)]);
+    if (RejectEarly(u, bound, GIAWeight, GMaxWeight))
+        return _Reject(ADD_DELTA_INTERACTION, WEIGHT_BOUND);
 
-    Complex GMBWeight = G->Weight(INVERSE(dir), Masha->R, RB, Masha->Tau, tauA,
-                                  Masha->Spin(dir), spinB[INVERSE(dir)],
-                                  false); //IsMeasure
+    Amplitude GMBWeight = G->Weight<false>(INVERSE(dir), Masha->R, RB, Masha->Tau, tauA,
+                                         Masha->Spin(dir), spinB[INVERSE(dir)]);
+    if (RejectEarly(u, bound, GMBWeight, GMaxWeight))
+        return _Reject(ADD_DELTA_INTERACTION, WEIGHT_BOUND);
 
-    Complex GACWeight = G->Weight(INVERSE(dir), RA, vC->R, tauA, vC->Tau,
+    Amplitude GACWeight = G->Weight(INVERSE(dir), RA, vC->R, tauA, vC->Tau,
                                   spinA[dir], vC->Spin(INVERSE(dir)), GIC->IsMeasure);
+    if (RejectEarly(u, bound, GACWeight, GMaxWeight))
+        return _Reject(ADD_DELTA_INTERACTION, WEIGHT_BOUND);
 
-    Complex GBDWeight = G->Weight(INVERSE(dir), RB, vD->R, tauA, vD->Tau,
+    Amplitude GBDWeight = G->Weight(INVERSE(dir), RB, vD->R, tauA, vD->Tau,
                                   spinB[dir], vD->Spin(INVERSE(dir)), GMD->IsMeasure);
 
-    Complex weightRatio = (-1) * GIAWeight * GMBWeight * wWeight * GACWeight * GBDWeight / (GIC->Weight * GMD->Weight);
+    Amplitude weightRatio = (-1) * GIAWeight * GMBWeight * wWeight * GACWeight * GBDWeight / (GIC->Weight * GMD->Weight);
 
     real prob = mod(weightRatio);
-    Complex sgn = phase(weightRatio);
+    Amplitude sgn = phase(weightRatio);
 
-    prob *= OrderReWeight[Diag->Order + 1] * ProbofCall[DEL_DELTA_INTERACTION] / (ProbofCall[ADD_DELTA_INTERACTION] * OrderReWeight[Diag->Order] * ProbTau(tauA));
+    prob *= probFactor;
 
-    Proposed[ADD_DELTA_INTERACTION][Diag->Order] += 1.0;
-    if (prob >= 1.0 || RNG->urn() < prob) {
+    if (u < prob) {
         Accepted[ADD_DELTA_INTERACTION][Diag->Order] += 1.0;
         Diag->Order += 1;
         Diag->Phase *= sgn;
@@ -882,56 +1267,56 @@ void Markov::AddDeltaInteraction()
 void Markov::DeleteDeltaInteraction()
 {
     if (!Worm->Exist)
-        return;
+        return _Reject(DEL_DELTA_INTERACTION, WRONG_SECTOR);
     if (Diag->Order <= 1)
-        return;
+        return _Reject(DEL_DELTA_INTERACTION, WRONG_SECTOR);
     vertex Ira = Worm->Ira, Masha = Worm->Masha;
 
     int dir = RandomPickDir();
     gLine GIA = Ira->NeighG(dir), GMB = Masha->NeighG(dir);
     if (GIA->IsMeasure)
-        return;
+        return _Reject(DEL_DELTA_INTERACTION, MEASURE_LINE);
     if (GMB->IsMeasure)
-        return;
+        return _Reject(DEL_DELTA_INTERACTION, MEASURE_LINE);
 
     vertex vA = GIA->NeighVer(dir), vB = GMB->NeighVer(dir);
     if (vA->Spin(IN) != vA->Spin(OUT))
-        return;
+        return _Reject(DEL_DELTA_INTERACTION, SPIN_CONFLICT);
     if (vB->Spin(IN) != vB->Spin(OUT))
-        return;
+        return _Reject(DEL_DELTA_INTERACTION, SPIN_CONFLICT);
 
     if (vA->NeighW() != vB->NeighW())
-        return;
+        return _Reject(DEL_DELTA_INTERACTION, TOPOLOGY);
 
     wLine wAB = vA->NeighW();
     if (wAB->IsMeasure)
-        return;
+        return _Reject(DEL_DELTA_INTERACTION, MEASURE_LINE);
     if (wAB->IsWorm)
-        return;
+        return _Reject(DEL_DELTA_INTERACTION, WORM_LINE);
     if (!wAB->IsDelta)
-        return;
+        return _Reject(DEL_DELTA_INTERACTION, DELTA_LINE);
 
     gLine GAC = vA->NeighG(dir), GBD = vB->NeighG(dir);
     vertex vC = GAC->NeighVer(dir), vD = GBD->NeighVer(dir);
     if (vA->R != vC->R)
-        return;
+        return _Reject(DEL_DELTA_INTERACTION, SITE_MISMATCH);
     if (vB->R != vD->R)
-        return;
+        return _Reject(DEL_DELTA_INTERACTION, SITE_MISMATCH);
 
     Momentum kWorm = Worm->K + SIGN(vA->Dir) * wAB->K;
 
-    Complex GICWeight = G->Weight(INVERSE(dir), Ira->R, vC->R, Ira->Tau, vC->Tau,
+    Amplitude GICWeight = G->Weight(INVERSE(dir), Ira->R, vC->R, Ira->Tau, vC->Tau,
                                   Ira->Spin(dir), vC->Spin(INVERSE(dir)), GAC->IsMeasure);
 
-    Complex GMDWeight = G->Weight(INVERSE(dir), Masha->R, vD->R, Masha->Tau, vD->Tau,
+    Amplitude GMDWeight = G->Weight(INVERSE(dir), Masha->R, vD->R, Masha->Tau, vD->Tau,
                                   Masha->Spin(dir), vD->Spin(INVERSE(dir)), GBD->IsMeasure);
 
-    Complex weightRatio = (-1) * GICWeight * GMDWeight / (GIA->Weight * GMB->Weight * GAC->Weight * GBD->Weight * wAB->Weight);
+    Amplitude weightRatio = (-1) * GICWeight * GMDWeight / (GIA->Weight * GMB->Weight * GAC->Weight * GBD->Weight * wAB->Weight);
 
     real prob = mod(weightRatio);
-    Complex sgn = phase(weightRatio);
+    Amplitude sgn = phase(weightRatio);
 
-    prob *= OrderReWeight[Diag->Order - 1] * ProbofCall[ADD_DELTA_INTERACTION] * ProbTau(vA->Tau) / (ProbofCall[DEL_DELTA_INTERACTION] * OrderReWeight[Diag->Order]);
+    prob *= OrderReWeight[Diag->Order - 1] * ProbofCall[_Sector()][ADD_DELTA_INTERACTION] * ProbTau(vA->Tau, Ira->Tau, dir, GIA->Spin(), Ira->R.Sublattice, vA->R.Sublattice) / (ProbofCall[_Sector()][DEL_DELTA_INTERACTION] * OrderReWeight[Diag->Order]);
 
     Proposed[DEL_DELTA_INTERACTION][Diag->Order] += 1.0;
     if (prob >= 1.0 || RNG->urn() < prob) {
@@ -971,66 +1356,106 @@ void Markov::DeleteDeltaInteraction()
 void Markov::ChangeTauOnVertex()
 {
     if (Diag->Order == 0 || Worm->Exist)
-        return;
+        return _Reject(CHANGE_TAU_VERTEX, WRONG_SECTOR);
     vertex ver = Diag->Ver.RandomPick(*RNG);
     wLine w = ver->NeighW();
     if (w->IsDelta)
-        return;
-
-    real tau = RandomPickTau();
+        return _Reject(CHANGE_TAU_VERTEX, DELTA_LINE);
 
+    //multiple-try Metropolis with independent candidates: pick one of the K candidates with
+    //probability proportional to its weight, accept it with sum(w)/(sum(w)-w(new)+w(old)),
+    //where w=|weight ratio|/ProbTau. K=1 is the plain Metropolis update.
+    //Candidates are sampled relative to the vertex before ver on the incoming G line, which does not move.
     gLine gin = ver->NeighG(IN), gout = ver->NeighG(OUT);
-    Complex ginWeight, goutWeight;
+    vertex vRef = gin->NeighVer(IN);
+    spin spinRef = gin->Spin();
+    int K = TauTrials;
+    real tau[MAX_TAU_TRIALS], tauFixed[MAX_TAU_TRIALS];
+    for (int i = 0; i < K; i++)
+        if (gin == gout)
+            tau[i] = RandomPickTau();
+        else
+            tau[i] = RandomPickTau(vRef->Tau, OUT, spinRef, vRef->R.Sublattice, ver->R.Sublattice);
+
+    Amplitude ginWeight[MAX_TAU_TRIALS], goutWeight[MAX_TAU_TRIALS];
     if (gin == gout) {
         //TODO:change to G(-0)
-        ginWeight = G->Weight(gin->NeighVer(IN)->R, ver->R,
-                              tau, tau,
-                              gin->NeighVer(IN)->Spin(OUT), ver->Spin(IN),
-                              gin->IsMeasure);
+        G->Weight(gin->NeighVer(IN)->R, ver->R,
+                  tau, tau,
+                  gin->NeighVer(IN)->Spin(OUT), ver->Spin(IN),
+                  gin->IsMeasure, K, ginWeight);
     }
     else {
-        ginWeight = G->Weight(gin->NeighVer(IN)->R, ver->R,
-                              gin->NeighVer(IN)->Tau, tau,
-                              gin->NeighVer(IN)->Spin(OUT), ver->Spin(IN),
-                              gin->IsMeasure);
-        goutWeight = G->Weight(ver->R, gout->NeighVer(OUT)->R,
-                               tau, gout->NeighVer(OUT)->Tau,
-                               ver->Spin(OUT), gout->NeighVer(OUT)->Spin(IN),
-                               gout->IsMeasure);
+        InitialArray(tauFixed, gin->NeighVer(IN)->Tau, K);
+        G->Weight(gin->NeighVer(IN)->R, ver->R,
+                  tauFixed, tau,
+                  gin->NeighVer(IN)->Spin(OUT), ver->Spin(IN),
+                  gin->IsMeasure, K, ginWeight);
+        InitialArray(tauFixed, gout->NeighVer(OUT)->Tau, K);
+        G->Weight(ver->R, gout->NeighVer(OUT)->R,
+                  tau, tauFixed,
+                  ver->Spin(OUT), gout->NeighVer(OUT)->Spin(IN),
+                  gout->IsMeasure, K, goutWeight);
     }
 
     vertex vW = w->NeighVer(INVERSE(ver->Dir));
-    Complex wWeight;
+    Amplitude wWeight[MAX_TAU_TRIALS];
     if (vW == ver)
-        wWeight = W->Weight(ver->Dir, ver->R, vW->R, tau, tau, ver->Spin(), vW->Spin(),
-                            w->IsWorm, w->IsMeasure, w->IsDelta);
-    else
-        wWeight = W->Weight(ver->Dir, ver->R, vW->R, tau, vW->Tau, ver->Spin(), vW->Spin(),
-                            w->IsWorm, w->IsMeasure, w->IsDelta);
-
-    Complex weightRatio = ginWeight * goutWeight * wWeight / (gin->Weight * gout->Weight * w->Weight);
+        W->Weight(ver->Dir, ver->R, vW->R, tau, tau, ver->Spin(), vW->Spin(),
+                  w->IsWorm, w->IsMeasure, w->IsDelta, K, wWeight);
+    else {
+        InitialArray(tauFixed, vW->Tau, K);
+        W->Weight(ver->Dir, ver->R, vW->R, tau, tauFixed, ver->Spin(), vW->Spin(),
+                  w->IsWorm, w->IsMeasure, w->IsDelta, K, wWeight);
+    }
 
+    Amplitude oldWeight = gin->Weight * gout->Weight * w->Weight;
     if (gin == gout)
-        weightRatio = ginWeight * wWeight / (gin->Weight * w->Weight);
+        oldWeight = gin->Weight * w->Weight;
+
+    Amplitude weightRatio[MAX_TAU_TRIALS];
+    real trial[MAX_TAU_TRIALS], sum = 0.0;
+    for (int i = 0; i < K; i++) {
+        if (gin == gout)
+            weightRatio[i] = ginWeight[i] * wWeight[i] / oldWeight;
+        else
+            weightRatio[i] = ginWeight[i] * goutWeight[i] * wWeight[i] / oldWeight;
+        if (gin == gout)
+            trial[i] = mod(weightRatio[i]) / ProbTau(tau[i]);
+        else
+            trial[i] = mod(weightRatio[i]) / ProbTau(tau[i], vRef->Tau, OUT, spinRef, vRef->R.Sublattice, ver->R.Sublattice);
+        sum += trial[i];
+    }
 
-    real prob = mod(weightRatio);
-    Complex sgn = phase(weightRatio);
+    Proposed[CHANGE_TAU_VERTEX][Diag->Order] += 1.0;
+    if (sum <= 0.0)
+        return;
 
-    prob *= ProbTau(ver->Tau) / ProbTau(tau);
+    int pick = 0;
+    if (K > 1) {
+        real x = RNG->urn() * sum;
+        while (pick < K - 1 && x >= trial[pick]) {
+            x -= trial[pick];
+            pick++;
+        }
+    }
+
+    real probOld = (gin == gout ? ProbTau(ver->Tau) : ProbTau(ver->Tau, vRef->Tau, OUT, spinRef, vRef->R.Sublattice, ver->R.Sublattice));
+    real prob = sum / (sum - trial[pick] + 1.0 / probOld);
+    Amplitude sgn = phase(weightRatio[pick]);
 
-    Proposed[CHANGE_TAU_VERTEX][Diag->Order] += 1.0;
     if (prob >= 1.0 || RNG->urn() < prob) {
         Accepted[CHANGE_TAU_VERTEX][Diag->Order] += 1.0;
 
         Diag->Phase *= sgn;
-        Diag->Weight *= weightRatio;
+        Diag->Weight *= weightRatio[pick];
 
-        ver->Tau = tau;
+        ver->Tau = tau[pick];
 
-        gin->Weight = ginWeight;
+        gin->Weight = ginWeight[pick];
         if (gout != gin)
-            gout->Weight = goutWeight;
-        w->Weight = wWeight;
+            gout->Weight = goutWeight[pick];
+        w->Weight = wWeight[pick];
     }
 }
 
@@ -1041,7 +1466,7 @@ void Markov::ChangeSpinOnVertex()
 {
     //TODO: If W is spin conserved, return;
     if (Diag->Order == 0 || Worm->Exist)
-        return;
+        return _Reject(CHANGE_SPIN_VERTEX, WRONG_SECTOR);
     vertex v1 = Diag->Ver.RandomPick(*RNG);
     wLine w1 = v1->NeighW();
     int dir = RandomPickDir();
@@ -1059,7 +1484,7 @@ void Markov::ChangeSpinOnVertex()
     spinv[dir] = spinv1[dir];
     spinv[INVERSE(dir)] = spinv2[INVERSE(dir)];
 
-    Complex gWeight, w1Weight, w2Weight;
+    Amplitude gWeight, w1Weight, w2Weight;
     if (w1 == w2) {
 
         w1Weight = W->Weight(v1->Dir, v1->R, w1->NeighVer(INVERSE(v1->Dir))->R,
@@ -1084,13 +1509,13 @@ void Markov::ChangeSpinOnVertex()
                             spinv2[INVERSE(dir)], spinv1[dir], g->IsMeasure);
     }
 
-    Complex weightRatio = gWeight * w1Weight * w2Weight / (g->Weight * w1->Weight * w2->Weight);
+    Amplitude weightRatio = gWeight * w1Weight * w2Weight / (g->Weight * w1->Weight * w2->Weight);
 
     if (w1 == w2)
         weightRatio = gWeight * w1Weight / (g->Weight * w1->Weight);
 
     real prob = mod(weightRatio);
-    Complex sgn = phase(weightRatio);
+    Amplitude sgn = phase(weightRatio);
 
     Proposed[CHANGE_SPIN_VERTEX][Diag->Order] += 1.0;
     if (prob >= 1.0 || RNG->urn() < prob) {
@@ -1116,13 +1541,18 @@ void Markov::ChangeSpinOnVertex()
 void Markov::ChangeROnVertex()
 {
     if (Diag->Order == 0 || Worm->Exist)
-        return;
+        return _Reject(CHANGE_R_VERTEX, WRONG_SECTOR);
     //TODO: Return if G is local
     vertex ver = Diag->Ver.RandomPick(*RNG);
-    Site site = RandomPickSite();
+    wLine w = ver->NeighW();
+    vertex vW = w->NeighVer(INVERSE(ver->Dir));
+    //the site is proposed relative to the other end of the W line, which does not move
+    Site site = (vW == ver ? RandomPickSite() : RandomPickSite(vW->R, ver->Dir));
+    if (vW != ver && !w->IsMeasure && !W->IsInRange(site, vW->R))
+        return _Reject(CHANGE_R_VERTEX, OUT_OF_RANGE);
     gLine gin = ver->NeighG(IN), gout = ver->NeighG(OUT);
 
-    Complex ginWeight, goutWeight, wWeight;
+    Amplitude ginWeight, goutWeight, wWeight;
     if (gin == gout) {
         ginWeight = G->Weight(site, site,
                               gin->NeighVer(IN)->Tau, ver->Tau,
@@ -1140,9 +1570,6 @@ void Markov::ChangeROnVertex()
                                gout->IsMeasure);
     }
 
-    wLine w = ver->NeighW();
-    vertex vW = w->NeighVer(INVERSE(ver->Dir));
-
     if (vW == ver)
         wWeight = W->Weight(ver->Dir, site, site, ver->Tau, vW->Tau, ver->Spin(), vW->Spin(),
                             w->IsWorm, w->IsMeasure, w->IsDelta);
@@ -1150,15 +1577,18 @@ void Markov::ChangeROnVertex()
         wWeight = W->Weight(ver->Dir, site, vW->R, ver->Tau, vW->Tau, ver->Spin(), vW->Spin(),
                             w->IsWorm, w->IsMeasure, w->IsDelta);
 
-    Complex weightRatio = ginWeight * goutWeight * wWeight / (gin->Weight * gout->Weight * w->Weight);
+    Amplitude weightRatio = ginWeight * goutWeight * wWeight / (gin->Weight * gout->Weight * w->Weight);
 
     if (gin == gout)
         weightRatio = ginWeight * wWeight / (gin->Weight * w->Weight);
 
     real prob = mod(weightRatio);
-    Complex sgn = phase(weightRatio);
+    Amplitude sgn = phase(weightRatio);
 
-    prob *= ProbSite(ver->R) / ProbSite(site);
+    if (vW == ver)
+        prob *= ProbSite(ver->R) / ProbSite(site);
+    else
+        prob *= ProbSite(ver->R, vW->R, ver->Dir) / ProbSite(site, vW->R, ver->Dir);
 
     Proposed[CHANGE_R_VERTEX][Diag->Order] += 1.0;
     if (prob >= 1.0 || RNG->urn() < prob) {
@@ -1181,7 +1611,7 @@ void Markov::ChangeROnVertex()
 void Markov::ChangeRLoop()
 {
     if (Diag->Order == 0 || Worm->Exist)
-        return;
+        return _Reject(CHANGE_R_LOOP, WRONG_SECTOR);
     //TODO: If G is not a local function, return;
     //TODO: use key word 'static' here to save time
     ASSERT_ALLWAYS(Order <= MAX_ORDER, "Order is too high!");
@@ -1198,21 +1628,31 @@ void Markov::ChangeRLoop()
         v[n + 1] = v[n]->NeighG(OUT)->NeighVer(OUT);
 
         if (v[n + 1]->R != oldR)
-            return;
+            return _Reject(CHANGE_R_LOOP, SITE_MISMATCH);
         n++;
     }
 
-    Site newR = RandomPickSite();
+    //the site is proposed relative to the W partner of v[0] if the partner is outside the loop
+    wLine w0 = v[0]->NeighW();
+    vertex vPartner = w0->NeighVer(INVERSE(v[0]->Dir));
+    bool IsPartnerFixed = (flagW[w0->Name] == 1);
+    Site newR = (IsPartnerFixed ? RandomPickSite(vPartner->R, v[0]->Dir) : RandomPickSite());
+    //the W lines to vertices outside the loop are stretched
+    for (int i = 0; i < n; i++) {
+        wLine wi = v[i]->NeighW();
+        if (flagW[wi->Name] == 1 && !wi->IsMeasure && !W->IsInRange(newR, wi->NeighVer(INVERSE(v[i]->Dir))->R))
+            return _Reject(CHANGE_R_LOOP, OUT_OF_RANGE);
+    }
 
     gLine g = nullptr;
     wLine w = nullptr;
 
     //TODO: use key word 'static' here to save time
-    Complex GWeight[2 * MAX_ORDER] = {Complex(1.0, 0.0)};
-    Complex WWeight[2 * MAX_ORDER] = {Complex(1.0, 0.0)};
+    Amplitude GWeight[2 * MAX_ORDER] = {Amplitude(1.0)};
+    Amplitude WWeight[2 * MAX_ORDER] = {Amplitude(1.0)};
 
-    Complex oldWeight(1.0, 0.0);
-    Complex newWeight(1.0, 0.0);
+    Amplitude oldWeight(1.0);
+    Amplitude newWeight(1.0);
 
     for (int i = 0; i < n; i++) {
         g = v[i]->NeighG(OUT);
@@ -1247,11 +1687,14 @@ void Markov::ChangeRLoop()
         }
     }
 
-    Complex weightRatio = newWeight / oldWeight;
+    Amplitude weightRatio = newWeight / oldWeight;
     real prob = mod(weightRatio);
-    Complex sgn = phase(weightRatio);
+    Amplitude sgn = phase(weightRatio);
 
-    prob *= ProbSite(oldR) / ProbSite(newR);
+    if (IsPartnerFixed)
+        prob *= ProbSite(oldR, vPartner->R, v[0]->Dir) / ProbSite(newR, vPartner->R, v[0]->Dir);
+    else
+        prob *= ProbSite(oldR) / ProbSite(newR);
 
     Proposed[CHANGE_R_LOOP][Diag->Order] += 1.0;
     if (prob >= 1.0 || RNG->urn() < prob) {
@@ -1273,31 +1716,28 @@ void Markov::ChangeRLoop()
 void Markov::ChangeMeasureFromGToW()
 {
     if (Diag->Order == 0 || Worm->Exist || !Diag->MeasureGLine)
-        return;
+        return _Reject(CHANGE_MEASURE_G2W, WRONG_SECTOR);
 
     wLine w = Diag->W.RandomPick(*RNG);
     if (w->IsDelta)
-        return;
+        return _Reject(CHANGE_MEASURE_G2W, DELTA_LINE);
 
     gLine g = Diag->GMeasure;
-    Complex gWeight = G->Weight(g->NeighVer(IN)->R, g->NeighVer(OUT)->R,
-                                g->NeighVer(IN)->Tau, g->NeighVer(OUT)->Tau,
-                                g->Spin(), g->Spin(),
-                                false); //IsMeasure
-
-    Complex wWeight = W->Weight(w->NeighVer(IN)->R, w->NeighVer(OUT)->R,
-                                w->NeighVer(IN)->Tau, w->NeighVer(OUT)->Tau,
-                                w->NeighVer(IN)->Spin(), w->NeighVer(OUT)->Spin(),
-                                w->IsWorm,
-                                true, //IsMeasure
-                                w->IsDelta);
-
-    Complex weightRatio = gWeight * wWeight / (g->Weight * w->Weight);
+    Amplitude gWeight = G->Weight<false>(g->NeighVer(IN)->R, g->NeighVer(OUT)->R,
+                                       g->NeighVer(IN)->Tau, g->NeighVer(OUT)->Tau,
+                                       g->Spin(), g->Spin());
+
+    //no worm exists and delta lines are rejected
+    Amplitude wWeight = W->Weight<false, true, false>(w->NeighVer(IN)->R, w->NeighVer(OUT)->R,
+                                                    w->NeighVer(IN)->Tau, w->NeighVer(OUT)->Tau,
+                                                    w->NeighVer(IN)->Spin(), w->NeighVer(OUT)->Spin());
+
+    Amplitude weightRatio = gWeight * wWeight / (g->Weight * w->Weight);
     real prob = mod(weightRatio);
-    Complex sgn = phase(weightRatio);
+    Amplitude sgn = phase(weightRatio);
 
     //proposal probility: (1/2N)/(1/N)
-    prob *= 0.5 * (*PolarReweight) * ProbofCall[CHANGE_MEASURE_W2G] / (ProbofCall[CHANGE_MEASURE_G2W]);
+    prob *= 0.5 * (*PolarReweight) * ProbofCall[_Sector(false, Diag->Order, false)][CHANGE_MEASURE_W2G] / (ProbofCall[_Sector()][CHANGE_MEASURE_G2W]);
 
     Proposed[CHANGE_MEASURE_G2W][Diag->Order] += 1.0;
     if (prob >= 1.0 || RNG->urn() < prob) {
@@ -1323,31 +1763,28 @@ void Markov::ChangeMeasureFromGToW()
 void Markov::ChangeMeasureFromWToG()
 {
     if (Diag->Order == 0 || Worm->Exist || Diag->MeasureGLine)
-        return;
+        return _Reject(CHANGE_MEASURE_W2G, WRONG_SECTOR);
 
     gLine g = Diag->G.RandomPick(*RNG);
 
     wLine w = Diag->WMeasure;
     if (w->IsDelta)
-        return;
+        return _Reject(CHANGE_MEASURE_W2G, DELTA_LINE);
 
-    Complex gWeight = G->Weight(g->NeighVer(IN)->R, g->NeighVer(OUT)->R,
-                                g->NeighVer(IN)->Tau, g->NeighVer(OUT)->Tau,
-                                g->Spin(), g->Spin(),
-                                true); //IsMeasure
+    Amplitude gWeight = G->Weight<true>(g->NeighVer(IN)->R, g->NeighVer(OUT)->R,
+                                      g->NeighVer(IN)->Tau, g->NeighVer(OUT)->Tau,
+                                      g->Spin(), g->Spin());
 
-    Complex wWeight = W->Weight(w->NeighVer(IN)->R, w->NeighVer(OUT)->R,
-                                w->NeighVer(IN)->Tau, w->NeighVer(OUT)->Tau,
-                                w->NeighVer(IN)->Spin(), w->NeighVer(OUT)->Spin(),
-                                w->IsWorm,
-                                false, //IsMeasure
-                                w->IsDelta);
+    //no worm exists and delta lines are rejected
+    Amplitude wWeight = W->Weight<false, false, false>(w->NeighVer(IN)->R, w->NeighVer(OUT)->R,
+                                                     w->NeighVer(IN)->Tau, w->NeighVer(OUT)->Tau,
+                                                     w->NeighVer(IN)->Spin(), w->NeighVer(OUT)->Spin());
 
-    Complex weightRatio = gWeight * wWeight / (g->Weight * w->Weight);
+    Amplitude weightRatio = gWeight * wWeight / (g->Weight * w->Weight);
     real prob = mod(weightRatio);
-    Complex sgn = phase(weightRatio);
+    Amplitude sgn = phase(weightRatio);
 
-    prob *= ProbofCall[CHANGE_MEASURE_G2W] / (0.5 * (*PolarReweight) * ProbofCall[CHANGE_MEASURE_W2G]);
+    prob *= ProbofCall[_Sector(false, Diag->Order, true)][CHANGE_MEASURE_G2W] / (0.5 * (*PolarReweight) * ProbofCall[_Sector()][CHANGE_MEASURE_W2G]);
 
     Proposed[CHANGE_MEASURE_W2G][Diag->Order] += 1.0;
     if (prob >= 1.0 || RNG->urn() < prob) {
@@ -1373,18 +1810,19 @@ void Markov::ChangeMeasureFromWToG()
 void Markov::ChangeDeltaToContinuous()
 {
     if (Diag->Order < 2 || Worm->Exist)
-        return;
+        return _Reject(CHANGE_DELTA2CONTINUS, WRONG_SECTOR);
     wLine w = Diag->W.RandomPick(*RNG);
-    if ((!w->IsDelta) || w->IsMeasure)
-        return;
+    if (!w->IsDelta)
+        return _Reject(CHANGE_DELTA2CONTINUS, DELTA_LINE);
+    if (w->IsMeasure)
+        return _Reject(CHANGE_DELTA2CONTINUS, MEASURE_LINE);
     vertex vin = w->NeighVer(IN), vout = w->NeighVer(OUT);
     gLine G1 = vout->NeighG(IN), G2 = vout->NeighG(OUT);
     real tau = RandomPickTau();
-    Complex wWeight = W->Weight(vin->R, vout->R, vin->Tau, tau, vin->Spin(),
-                                vout->Spin(), w->IsWorm, w->IsMeasure,
-                                false); //IsDelta
+    //no worm exists and measuring lines are rejected
+    Amplitude wWeight = W->Weight<false, false, false>(vin->R, vout->R, vin->Tau, tau, vin->Spin(), vout->Spin());
 
-    Complex G1Weight, G2Weight, weightRatio;
+    Amplitude G1Weight, G2Weight, weightRatio;
     if (G1 == G2) {
         G1Weight = G->Weight(G1->NeighVer(IN)->R, vout->R,
                              tau, tau,
@@ -1406,9 +1844,9 @@ void Markov::ChangeDeltaToContinuous()
     }
 
     real prob = mod(weightRatio);
-    Complex sgn = phase(weightRatio);
+    Amplitude sgn = phase(weightRatio);
 
-    prob *= ProbofCall[CHANGE_CONTINUS2DELTA] / (ProbofCall[CHANGE_DELTA2CONTINUS] * ProbTau(tau));
+    prob *= ProbofCall[_Sector()][CHANGE_CONTINUS2DELTA] / (ProbofCall[_Sector()][CHANGE_DELTA2CONTINUS] * ProbTau(tau));
 
     Proposed[CHANGE_DELTA2CONTINUS][Diag->Order] += 1.0;
     if (prob >= 1.0 || RNG->urn() < prob) {
@@ -1432,20 +1870,21 @@ void Markov::ChangeDeltaToContinuous()
 void Markov::ChangeContinuousToDelta()
 {
     if (Diag->Order < 2 || Worm->Exist)
-        return;
+        return _Reject(CHANGE_CONTINUS2DELTA, WRONG_SECTOR);
 
     wLine w = Diag->W.RandomPick(*RNG);
-    if (w->IsDelta || w->IsMeasure)
-        return;
+    if (w->IsDelta)
+        return _Reject(CHANGE_CONTINUS2DELTA, DELTA_LINE);
+    if (w->IsMeasure)
+        return _Reject(CHANGE_CONTINUS2DELTA, MEASURE_LINE);
 
     vertex vin = w->NeighVer(IN), vout = w->NeighVer(OUT);
     gLine G1 = vout->NeighG(IN), G2 = vout->NeighG(OUT);
 
-    Complex wWeight = W->Weight(vin->R, vout->R, vin->Tau, vin->Tau, vin->Spin(),
-                                vout->Spin(), w->IsWorm, w->IsMeasure,
-                                true); //IsDelta
+    //no worm exists and measuring lines are rejected
+    Amplitude wWeight = W->Weight<false, false, true>(vin->R, vout->R, vin->Tau, vin->Tau, vin->Spin(), vout->Spin());
 
-    Complex G1Weight, G2Weight, weightRatio;
+    Amplitude G1Weight, G2Weight, weightRatio;
     if (G1 == G2) {
         G1Weight = G->Weight(G1->NeighVer(IN)->R, vout->R,
                              vin->Tau, vin->Tau,
@@ -1466,9 +1905,9 @@ void Markov::ChangeContinuousToDelta()
     }
 
     real prob = mod(weightRatio);
-    Complex sgn = phase(weightRatio);
+    Amplitude sgn = phase(weightRatio);
 
-    prob *= ProbofCall[CHANGE_DELTA2CONTINUS] * ProbTau(vout->Tau) / ProbofCall[CHANGE_CONTINUS2DELTA];
+    prob *= ProbofCall[_Sector()][CHANGE_DELTA2CONTINUS] * ProbTau(vout->Tau) / ProbofCall[_Sector()][CHANGE_CONTINUS2DELTA];
 
     Proposed[CHANGE_CONTINUS2DELTA][Diag->Order] += 1.0;
     if (prob >= 1.0 || RNG->urn() < prob) {
@@ -1489,20 +1928,20 @@ void Markov::ChangeContinuousToDelta()
 void Markov::JumpToOrder0()
 {
     if (Worm->Exist || Diag->Order != 1)
-        return;
+        return _Reject(JUMP_TO_ORDER0, WRONG_SECTOR);
 
     vertex Ver1 = &Diag->Ver[0];
     vertex Ver2 = &Diag->Ver[1];
     if (Ver1->R != Ver2->R)
-        return;
+        return _Reject(JUMP_TO_ORDER0, SITE_MISMATCH);
 
-    Complex weightRatio;
+    Amplitude weightRatio;
     weightRatio = weight::Norm::Weight() / Diag->Weight;
 
     real prob = mod(weightRatio);
-    Complex sgn = phase(weightRatio);
+    Amplitude sgn = phase(weightRatio);
 
-    prob *= (ProbofCall[JUMP_BACK_TO_ORDER1] * ProbSite(Ver1->R) * ProbTau(Ver1->Tau) * ProbTau(Ver2->Tau) * 0.5 * 0.5 * OrderReWeight[0]) / (ProbofCall[JUMP_TO_ORDER0] * OrderReWeight[1]);
+    prob *= (ProbofCall[_Sector(false, 0, Diag->MeasureGLine)][JUMP_BACK_TO_ORDER1] * ProbSite(Ver1->R) * ProbTau(Ver1->Tau) * ProbTau(Ver2->Tau) * 0.5 * 0.5 * OrderReWeight[0]) / (ProbofCall[_Sector()][JUMP_TO_ORDER0] * OrderReWeight[1]);
 
     Proposed[JUMP_TO_ORDER0][Diag->Order] += 1.0;
     if (prob >= 1.0 || RNG->urn() < prob) {
@@ -1516,7 +1955,7 @@ void Markov::JumpToOrder0()
 void Markov::JumpBackToOrder1()
 {
     if (Worm->Exist || Diag->Order != 0)
-        return;
+        return _Reject(JUMP_BACK_TO_ORDER1, WRONG_SECTOR);
 
     Site R = RandomPickSite();
     real Tau1 = RandomPickTau();
@@ -1533,15 +1972,15 @@ void Markov::JumpBackToOrder1()
     spin SpinV1[2] = {SpinG2, SpinG1};
     spin SpinV2[2] = {SpinG1, SpinG2};
 
-    Complex weightG1 = G->Weight(R, R, Tau1, Tau2, SpinG1, SpinG1, G1->IsMeasure);
-    Complex weightG2 = G->Weight(R, R, Tau2, Tau1, SpinG2, SpinG2, G2->IsMeasure);
-    Complex weightW = W->Weight(Ver1->Dir, R, R, Tau1, Tau2, SpinV1, SpinV2, false, W1->IsMeasure, W1->IsDelta);
+    Amplitude weightG1 = G->Weight(R, R, Tau1, Tau2, SpinG1, SpinG1, G1->IsMeasure);
+    Amplitude weightG2 = G->Weight(R, R, Tau2, Tau1, SpinG2, SpinG2, G2->IsMeasure);
+    Amplitude weightW = W->Weight(Ver1->Dir, R, R, Tau1, Tau2, SpinV1, SpinV2, false, W1->IsMeasure, W1->IsDelta);
 
-    Complex weightRatio = -1.0 * weightG1 * weightG2 * weightW / Diag->Weight;
+    Amplitude weightRatio = -1.0 * weightG1 * weightG2 * weightW / Diag->Weight;
     real prob = mod(weightRatio);
-    Complex sgn = phase(weightRatio);
+    Amplitude sgn = phase(weightRatio);
 
-    prob *= ProbofCall[JUMP_TO_ORDER0] * OrderReWeight[1] / (ProbofCall[JUMP_BACK_TO_ORDER1] * OrderReWeight[0] * ProbSite(R) * ProbTau(Tau1) * ProbTau(Tau2) * 0.5 * 0.5);
+    prob *= ProbofCall[_Sector(false, 1, Diag->MeasureGLine)][JUMP_TO_ORDER0] * OrderReWeight[1] / (ProbofCall[_Sector()][JUMP_BACK_TO_ORDER1] * OrderReWeight[0] * ProbSite(R) * ProbTau(Tau1) * ProbTau(Tau2) * 0.5 * 0.5);
 
     Proposed[JUMP_BACK_TO_ORDER1][Diag->Order] += 1.0;
     if (prob >= 1.0 || RNG->urn() < prob) {
@@ -1594,6 +2033,36 @@ real Markov::ProbTau(real tau)
     return 1.0 / Beta;
 }
 
+int Markov::_TauTableIndex(int dir, spin Spin, int SubRef, int SubNew)
+{
+    //tables are indexed by the sublattices of the IN and the OUT end of the line
+    if (dir == OUT)
+        return (Spin * NSublat + SubRef) * NSublat + SubNew;
+    else
+        return (Spin * NSublat + SubNew) * NSublat + SubRef;
+}
+
+real Markov::RandomPickTau(real tauRef, int dir, spin Spin, int SubRef, int SubNew)
+{
+    int bin = TauTable[_TauTableIndex(dir, Spin, SubRef, SubNew)].Sample(*RNG);
+    real dtau = (bin + RNG->urn()) * Beta / MaxTauBin;
+    real tau = (dir == OUT ? tauRef + dtau : tauRef - dtau);
+    if (tau >= Beta)
+        tau -= Beta;
+    else if (tau < 0.0)
+        tau += Beta;
+    return tau;
+}
+
+real Markov::ProbTau(real tau, real tauRef, int dir, spin Spin, int SubRef, int SubNew)
+{
+    real dtau = (dir == OUT ? tau - tauRef : tauRef - tau);
+    if (dtau < 0.0)
+        dtau += Beta;
+    int bin = min(int(dtau * MaxTauBin / Beta), MaxTauBin - 1);
+    return TauTable[_TauTableIndex(dir, Spin, SubRef, SubNew)].Prob(bin) * MaxTauBin / Beta;
+}
+
 bool Markov::RandomPickBool()
 {
     return (RNG->irn(0, 1) == 0 ? true : false);
@@ -1613,6 +2082,25 @@ real Markov::ProbSite(const Site &site)
     return 1.0 / (Lat->Vol * Lat->SublatVol);
 }
 
+Site Markov::RandomPickSite(const Site &Partner, int dir)
+{
+    int index = SiteTable[dir * NSublat + Partner.Sublattice].Sample(*RNG);
+    //the coordinate index of the W line is always the one of its OUT end relative to its IN end
+    Vec<int> coord = Lat->Index2Vec(index % Lat->Vol);
+    if (dir == OUT)
+        coord = Partner.Coordinate + coord;
+    else
+        coord = Partner.Coordinate - coord;
+    Lat->Shift(coord);
+    return Site(index / Lat->Vol, coord);
+}
+
+real Markov::ProbSite(const Site &site, const Site &Partner, int dir)
+{
+    int coord = (dir == OUT ? Lat->CoordiIndex(Partner, site) : Lat->CoordiIndex(site, Partner));
+    return SiteTable[dir * NSublat + Partner.Sublattice].Prob(site.Sublattice * Lat->Vol + coord);
+}
+
 /**
  *  determine whether a Ira can move around to another vertex
  *  used in CreateWorm
@@ -10,8 +10,11 @@
 #define __Feynman_Simulator__markov__
 
 #include <string>
+#include <vector>
 #include "utility/convention.h"
+#include "utility/alias_table.h"
 
+class Dictionary;
 namespace diag {
 class WormClass;
 class Diagram;
@@ -34,7 +37,21 @@ class Momentum;
 
 namespace mc {
 const int NUpdates = 19;
+//worm/physical, order 0/order>=1, G/W measuring line; worm only lives at order>=1
+const int NSectors = 6;
+//reasons for an update to return before its Metropolis step
+const int NRejections = 10;
+//maximum number of candidate times tried at once by ChangeTauOnVertex
+const int MAX_TAU_TRIALS = 16;
+//with CostTiming, one update in every CostSampling is timed to estimate the cost of each sector and order, a power of two
+const int CostSampling = 16;
+class MarkovWalkers;
+class MarkovMonitor;
 class Markov {
+    friend int BenchmarkMarkov(long long Calls);
+    friend class MarkovWalkers;
+    friend class MarkovMonitor;
+
 public:
     long long* Counter;
     real Beta;
@@ -43,6 +60,10 @@ public:
     real* OrderReWeight;
     real* WormSpaceReweight;
     real* PolarReweight;
+    int TauTrials;
+    //time the updates for ParaMC::CostReWeight, off otherwise so that Hop never reads the cycle counter
+    bool CostTiming;
+    std::vector<real>* FrozenUpdateWeight;
     diag::Diagram* Diag;
     diag::WormClass* Worm;
     weight::SigmaClass* Sigma;
@@ -50,11 +71,18 @@ public:
     weight::GClass* G;
     weight::WClass* W;
     RandomFactory* RNG;
+    //upper bounds of |G| and |W|, used to reject proposals before all new weights are looked up
+    real GMaxWeight;
+    real WMaxWeight;
 
     bool BuildNew(para::ParaMC&, diag::Diagram&, weight::Weight&);
     void Reset(para::ParaMC&, diag::Diagram&, weight::Weight&);
     void Hop(int);
     void PrintDetailBalanceInfo();
+    void TuneUpdateWeight();
+    Dictionary UpdateCostToDict();
+    Dictionary RejectionToDict();
+    void ClearCost();
 
     void CreateWorm();
     void DeleteWorm();
@@ -77,11 +105,28 @@ public:
     void ChangeSpinOnVertex();
 
 private:
-    real ProbofCall[NUpdates];
-    real SumofProbofCall[NUpdates];
+    //relative weight to call each update, before updates impossible in a sector are masked out
+    real UpdateWeight[NUpdates];
+    //normalized probability to call each update in each sector
+    real ProbofCall[NSectors][NUpdates];
+    AliasTable UpdateTable[NSectors];
     std::string OperationName[NUpdates];
     real Accepted[NUpdates][MAX_ORDER];
     real Proposed[NUpdates][MAX_ORDER];
+    //only counted in the PROFILE_UPDATES build
+    real Cycles[NUpdates][MAX_ORDER];
+    real HopCycles;
+    std::string RejectionName[NRejections];
+    real Rejected[NUpdates][NRejections][MAX_ORDER];
+    //cycles of the timed updates, and their number, in each sector and order since the last ClearCost
+    real SectorCycles[NSectors][MAX_ORDER];
+    real SectorSteps[NSectors][MAX_ORDER];
+    //distribution of the tau difference along a G line, built from |G|, for each spin and pair of sublattices
+    int MaxTauBin;
+    int NSublat;
+    std::vector<AliasTable> TauTable;
+    //distribution of the site of one end of a W line, built from |W|, for each end and sublattice of the other end
+    std::vector<AliasTable> SiteTable;
 
     int RandomPickDeltaSpin();
     spin RandomPickSpin();
@@ -89,8 +134,14 @@ private:
     int RandomPickDir();
     real RandomPickTau();
     real ProbTau(real);
+    //tau of a new vertex on the dir side of a vertex at tauRef, along a G line of the given spin
+    real RandomPickTau(real tauRef, int dir, spin, int SubRef, int SubNew);
+    real ProbTau(real tau, real tauRef, int dir, spin, int SubRef, int SubNew);
     Site RandomPickSite();
     real ProbSite(const Site&);
+    //site of a vertex on the dir end of a W line whose other end is at Partner
+    Site RandomPickSite(const Site& Partner, int dir);
+    real ProbSite(const Site&, const Site& Partner, int dir);
     bool RandomPickBool();
     enum Operations {
         CREATE_WORM = 0,
@@ -114,12 +165,44 @@ private:
         JUMP_BACK_TO_ORDER1,
         END
     };
+    enum Sectors {
+        PHY_ORDER0_G = 0,
+        PHY_ORDER0_W,
+        PHY_G,
+        PHY_W,
+        WORM_G,
+        WORM_W
+    };
+    enum Rejections {
+        WRONG_SECTOR = 0, //order or worm state does not allow the update
+        HASH_COLLISION, //the new momentum is already carried by another line
+        SPIN_CONFLICT,
+        MEASURE_LINE,
+        DELTA_LINE, //the line is (or is not) a delta interaction
+        WORM_LINE,
+        TOPOLOGY, //the picked vertices and lines do not have the required shape
+        SITE_MISMATCH,
+        WEIGHT_BOUND, //rejected by the upper bound of the weight ratio, before all weights are known
+        OUT_OF_RANGE //a new W line would join sites out of the range of W, where it is zero
+    };
+    void _Reject(Operations op, Rejections reason);
+    int _Sector(bool IsWorm, int order, bool IsMeasureG);
+    int _Sector();
+    bool _IsPossible(Operations op, int sector);
+    void _BuildUpdateTable();
+    void _BuildTauTable();
+    void _BuildSiteTable();
+    int _TauTableIndex(int dir, spin, int SubRef, int SubNew);
     std::string _DetailBalanceStr(Operations op);
+    std::string _CostStr(real cycles, real proposed);
+    std::string _RejectionStr(Operations op);
     std::string _CheckBalance(Operations op1, Operations op2);
     void _Initial(para::ParaMC&, diag::Diagram&, weight::Weight&);
 };
 
 int TestMarkov();
 int TestDiagCounter();
+int BenchmarkMarkov(long long Calls);
+int ValidatePrecision(long long Steps);
 }
 #endif /* defined(__Feynman_Simulator__markov__) */
@@ -0,0 +1,229 @@
+//
+//  markov_benchmark.cpp
+//  Feynman_Simulator
+//
+
+#include "markov_test.h"
+#include "markov_walkers.h"
+#include "module/weight/component.h"
+#include "utility/dictionary.h"
+#include <chrono>
+#include <cstring>
+using namespace std;
+using namespace mc;
+
+//Hop steps allowed to reach a configuration of the wanted order and worm state
+const long long MaxStepsToConfig = 10000000;
+
+/**
+*  Call every update alone for Calls times, in fixed configurations of each order built from
+*  Diagram::SetTest and Weight::SetTest, so that no input file is needed.
+*  Once an update changes the order or the worm state of the diagram, the configuration is restored
+*  outside the timed region. Orders the test weights can not reach are skipped.
+*  Many calls return before they propose anything, so the time is given per call and per proposal.
+*/
+int mc::BenchmarkMarkov(long long Calls)
+{
+    TestChain Test;
+    Test.Build();
+    auto& Para = Test.Para;
+    auto& Weight = Test.Weight;
+    auto& Diag = Test.Diag;
+    auto& markov = Test.Chain;
+
+    //accepted or proposed updates op summed over all orders, an update may move the diagram to another order
+    auto Total = [&](real(*count)[MAX_ORDER], int op) {
+        real sum = 0.0;
+        for (int o = 0; o <= Para.Order; o++)
+            sum += count[op][o];
+        return sum;
+    };
+
+    typedef void (Markov::*Update)();
+    Update Updates[NUpdates];
+    Updates[Markov::CREATE_WORM] = &Markov::CreateWorm;
+    Updates[Markov::DELETE_WORM] = &Markov::DeleteWorm;
+    Updates[Markov::MOVE_WORM_G] = &Markov::MoveWormOnG;
+    Updates[Markov::MOVE_WORM_W] = &Markov::MoveWormOnW;
+    Updates[Markov::RECONNECT] = &Markov::Reconnect;
+    Updates[Markov::ADD_INTERACTION] = &Markov::AddInteraction;
+    Updates[Markov::DEL_INTERACTION] = &Markov::DeleteInteraction;
+    Updates[Markov::ADD_DELTA_INTERACTION] = &Markov::AddDeltaInteraction;
+    Updates[Markov::DEL_DELTA_INTERACTION] = &Markov::DeleteDeltaInteraction;
+    Updates[Markov::CHANGE_TAU_VERTEX] = &Markov::ChangeTauOnVertex;
+    Updates[Markov::CHANGE_R_VERTEX] = &Markov::ChangeROnVertex;
+    Updates[Markov::CHANGE_R_LOOP] = &Markov::ChangeRLoop;
+    Updates[Markov::CHANGE_MEASURE_G2W] = &Markov::ChangeMeasureFromGToW;
+    Updates[Markov::CHANGE_MEASURE_W2G] = &Markov::ChangeMeasureFromWToG;
+    Updates[Markov::CHANGE_DELTA2CONTINUS] = &Markov::ChangeDeltaToContinuous;
+    Updates[Markov::CHANGE_CONTINUS2DELTA] = &Markov::ChangeContinuousToDelta;
+    Updates[Markov::CHANGE_SPIN_VERTEX] = &Markov::ChangeSpinOnVertex;
+    Updates[Markov::JUMP_TO_ORDER0] = &Markov::JumpToOrder0;
+    Updates[Markov::JUMP_BACK_TO_ORDER1] = &Markov::JumpBackToOrder1;
+
+    //configuration for the lock-step engine, which only works on physical diagrams at order>=1
+    Dictionary LockStepConfig;
+    string Output = "Benchmark of Markov updates, " + ToString(Calls) + " calls each:\n";
+    char temp[160];
+    sprintf(temp, "\t%-24s%6s%6s%15s%15s%15s%15s\n", "Update", "Order", "Worm", "ns/call", "ns/proposal", "ns/accepted", "AcceptRatio");
+    Output += temp;
+    for (int order = 0; order <= Para.Order; order++)
+        for (bool IsWorm : { false, true }) {
+            if (order == 0 && IsWorm)
+                continue;
+            long long step = 0;
+            while ((Diag.Order != order || Diag.Worm.Exist != IsWorm) && step < MaxStepsToConfig) {
+                markov.Hop(1);
+                step++;
+            }
+            if (step == MaxStepsToConfig) {
+                LOG_WARNING("Can not reach order " << order << " with worm " << IsWorm << ", skipped!");
+                continue;
+            }
+            diag::DiagramSnapshot Config;
+            Diag.ToSnapshot(Config);
+            int sector = markov._Sector();
+            if (order == 1 && !IsWorm)
+                LockStepConfig = Diag.ToDict();
+
+            for (int op = 0; op < Markov::END; op++) {
+                if (!markov._IsPossible(Markov::Operations(op), sector))
+                    continue;
+                real accepted = Total(markov.Accepted, op), proposed = Total(markov.Proposed, op);
+                chrono::duration<double, nano> elapsed(0.0);
+                long long call = 0;
+                while (call < Calls) {
+                    auto start = chrono::steady_clock::now();
+                    bool moved = false;
+                    while (call < Calls && !moved) {
+                        (markov.*Updates[op])();
+                        call++;
+                        moved = (Diag.Order != order || Diag.Worm.Exist != IsWorm);
+                    }
+                    elapsed += chrono::steady_clock::now() - start;
+                    if (moved)
+                        Diag.FromSnapshot(Config);
+                }
+                accepted = Total(markov.Accepted, op) - accepted;
+                proposed = Total(markov.Proposed, op) - proposed;
+                sprintf(temp, "\t%-24s%6i%6i%15g%15g%15g%15g\n", markov.OperationName[op].c_str(),
+                        order, IsWorm, elapsed.count() / Calls,
+                        proposed > 0.0 ? elapsed.count() / proposed : 0.0,
+                        accepted > 0.0 ? elapsed.count() / accepted : 0.0,
+                        proposed > 0.0 ? accepted / proposed : 0.0);
+                Output += temp;
+            }
+            Diag.FromSnapshot(Config);
+        }
+
+    //the same walkers change Tau in lock step, or one after another with the scalar update
+    for (bool IsLockStep : { true, false }) {
+        if (!LockStepConfig.HasKey("Ver"))
+            break;
+        Diag.FromDict(LockStepConfig);
+        MarkovWalkers Walkers;
+        Walkers.BuildNew(Para, Diag, Weight);
+        auto start = chrono::steady_clock::now();
+        for (long long call = 0; call < Calls; call++)
+            if (IsLockStep)
+                Walkers.ChangeTauOnVertex();
+            else
+                for (int l = 0; l < WALKER_LANES; l++)
+                    Walkers.Chain(l).ChangeTauOnVertex();
+        chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+        real accepted = 0.0, proposed = 0.0;
+        for (int l = 0; l < WALKER_LANES; l++)
+            for (int order = 0; order <= Para.Order; order++) {
+                accepted += Walkers.Chain(l).Accepted[Markov::CHANGE_TAU_VERTEX][order];
+                proposed += Walkers.Chain(l).Proposed[Markov::CHANGE_TAU_VERTEX][order];
+            }
+        sprintf(temp, "\t%-24s%6s%6i%15g%15g%15g%15g\n", IsLockStep ? "LOCKSTEP_CHANGE_TAU" : "SCALAR_CHANGE_TAU", "any", 0,
+                elapsed.count() / (Calls * WALKER_LANES),
+                proposed > 0.0 ? elapsed.count() / proposed : 0.0,
+                accepted > 0.0 ? elapsed.count() / accepted : 0.0,
+                proposed > 0.0 ? accepted / proposed : 0.0);
+        Output += temp;
+    }
+    LOG_INFO(Output);
+    return 0;
+}
+
+//Sweeps between two measurements of ValidatePrecision
+const int SweepsPerMeasure = 10;
+
+//|a-b|/|a| of two arrays of the same size
+real RelativeDeviation(Python::ArrayObject a, Python::ArrayObject b)
+{
+    real diff = 0.0, norm = 0.0;
+    for (uint i = 0; i < a.Size(); i++) {
+        diff += pow(mod(a.Data<Complex>()[i] - b.Data<Complex>()[i]), 2.0);
+        norm += pow(mod(a.Data<Complex>()[i]), 2.0);
+    }
+    return norm > 0.0 ? sqrt(diff / norm) : sqrt(diff);
+}
+
+real SigmaDeviation(TestChain Test[2])
+{
+    return RelativeDeviation(Test[0].Weight.Sigma->Estimator.ToDict().Get<Python::ArrayObject>("WeightAccu"),
+                             Test[1].Weight.Sigma->Estimator.ToDict().Get<Python::ArrayObject>("WeightAccu"));
+}
+
+real PolarDeviation(TestChain Test[2])
+{
+    return RelativeDeviation(Test[0].Weight.Polar->Estimator.ToDict().Get<Python::ArrayObject>("WeightAccu"),
+                             Test[1].Weight.Polar->Estimator.ToDict().Get<Python::ArrayObject>("WeightAccu"));
+}
+
+/**
+*  Run two chains from the same seed in the test configuration of BenchmarkMarkov, one with the G/W
+*  tables in double precision and one with the tables rounded as a SINGLE_PRECISION_WEIGHT build stores
+*  them, measuring Sigma and Polar after every SweepsPerMeasure sweeps for Steps steps.
+*  Both chains draw the same random numbers until an acceptance test falls the other way, so the step
+*  where the diagrams part is reported with the deviation of Sigma and Polar accumulated until then,
+*  which comes from the rounding alone, and at the end.
+*/
+int mc::ValidatePrecision(long long Steps)
+{
+#ifdef SINGLE_PRECISION_WEIGHT
+    LOG_WARNING("The tables are in single precision already, build without SINGLE_PRECISION_WEIGHT to compare!");
+    return 1;
+#else
+    TestChain Test[2];
+    for (int i = 0; i < 2; i++)
+        Test[i].Build();
+    Test[1].Weight.G->RoundToFloat();
+    Test[1].Weight.W->RoundToFloat();
+
+    long long Parted = -1;
+    real PartedSigma = 0.0, PartedPolar = 0.0;
+    diag::DiagramSnapshot Snap[2];
+    for (long long step = 0; step < Steps; step++) {
+        for (int i = 0; i < 2; i++)
+            Test[i].Chain.Hop(SweepsPerMeasure);
+        if (Parted < 0) {
+            for (int i = 0; i < 2; i++) {
+                memset(&Snap[i], 0, sizeof(Snap[i]));
+                Test[i].Diag.ToSnapshot(Snap[i]);
+            }
+            if (memcmp(&Snap[0], &Snap[1], sizeof(Snap[0])) != 0) {
+                Parted = step;
+                PartedSigma = SigmaDeviation(Test);
+                PartedPolar = PolarDeviation(Test);
+            }
+        }
+        for (int i = 0; i < 2; i++)
+            Test[i].Monitor.Measure();
+    }
+    string Output = "Single against double precision G/W tables, " + ToString(Steps) + " steps of "
+                    + ToString(SweepsPerMeasure) + " sweeps from the same seed:\n";
+    if (Parted < 0)
+        Output += "\tthe diagrams never parted\n";
+    else
+        Output += "\tthe diagrams parted at step " + ToString(Parted) + ", relative deviation of Sigma/Polar until then: "
+                  + ToString(PartedSigma) + "/" + ToString(PartedPolar) + "\n";
+    Output += "\trelative deviation of Sigma/Polar at the end: " + ToString(SigmaDeviation(Test)) + "/"
+              + ToString(PolarDeviation(Test)) + "\n";
+    LOG_INFO(Output);
+    return 0;
+#endif
+}
@@ -40,7 +40,7 @@ void Test_Counter()
     system("rm -rf diagram");
     system("mkdir diagram");
     sput_fail_unless(Diag.CheckDiagram(), "Check diagram G,W,Ver and Weight");
-    sput_fail_if(Equal(Diag.Weight, Complex(0.0, 0.0)), "Initialize diagram has nonzero weight");
+    sput_fail_if(Equal(Diag.Weight, Amplitude(0.0)), "Initialize diagram has nonzero weight");
 
     int sigma[MAX_ORDER] = { 0 };
     int polar[MAX_ORDER] = { 0 };
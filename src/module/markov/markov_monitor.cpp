@@ -7,19 +7,161 @@
 //
 
 #include "markov_monitor.h"
+#include "markov.h"
 #include "module/diagram/diagram.h"
 #include "module/parameter/parameter.h"
 #include "module/weight/weight.h"
 #include "module/weight/component.h"
 #include "utility/dictionary.h"
+#include "utility/spsc_ring.h"
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <math.h>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 using namespace std;
 using namespace diag;
 using namespace para;
 using namespace mc;
 
+//a Sigma/Polar measurement waiting to be added to the estimator
+struct MeasureRecord {
+    uint Index;
+    int Order;
+    bool IsSigma;
+    Amplitude Weight;
+};
+const uint PIPELINE_SIZE = 4096;
+
+class mc::MeasurePipeline {
+public:
+    SpscRing<MeasureRecord, PIPELINE_SIZE> Ring;
+    long long Pushed;
+    atomic<long long> Applied;
+    atomic<bool> Stop;
+    thread Consumer;
+#ifdef __linux__
+    //affinity of the Markov thread before it is pinned
+    bool Pinned;
+    cpu_set_t Affinity;
+#endif
+};
+
+#ifdef __linux__
+void PinThread(pthread_t thread, int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(thread, sizeof(set), &set) != 0)
+        LOG_WARNING("Fail to pin a thread on cpu " << cpu);
+}
+
+//pin the Markov thread on CPUs[0] and the consumer on CPUs[1], e.g. two hardware threads of one core
+void PinPipeline(MeasurePipeline& pipe, const vector<int>& CPUs)
+{
+    pipe.Pinned = false;
+    if (CPUs.empty())
+        return;
+    pipe.Pinned = (pthread_getaffinity_np(pthread_self(), sizeof(pipe.Affinity), &pipe.Affinity) == 0);
+    PinThread(pthread_self(), CPUs[0]);
+    if (CPUs.size() > 1)
+        PinThread(pipe.Consumer.native_handle(), CPUs[1]);
+}
+
+void UnpinPipeline(MeasurePipeline& pipe)
+{
+    if (pipe.Pinned)
+        pthread_setaffinity_np(pthread_self(), sizeof(pipe.Affinity), &pipe.Affinity);
+}
+#else
+void PinPipeline(MeasurePipeline& pipe, const vector<int>& CPUs)
+{
+    if (!CPUs.empty())
+        LOG_WARNING("Threads can only be pinned on linux!");
+}
+
+void UnpinPipeline(MeasurePipeline& pipe)
+{
+}
+#endif
+
 MarkovMonitor::MarkovMonitor()
+    : Chain(nullptr)
+    , _Pipeline(nullptr)
+{
+}
+
+MarkovMonitor::~MarkovMonitor()
+{
+    StopPipeline();
+}
+
+void MarkovMonitor::StartPipeline(const vector<int>& CPUs)
+{
+    if (_Pipeline != nullptr)
+        return;
+    _Pipeline = new MeasurePipeline;
+    _Pipeline->Pushed = 0;
+    _Pipeline->Applied = 0;
+    _Pipeline->Stop = false;
+    MeasurePipeline* pipe = _Pipeline;
+    weight::Weight* weight = Weight;
+    _Pipeline->Consumer = thread([pipe, weight]() {
+        MeasureRecord record;
+        int idle = 0;
+        while (true) {
+            if (pipe->Ring.Pop(record)) {
+                auto& estimator = record.IsSigma ? weight->Sigma->Estimator : weight->Polar->Estimator;
+                estimator.Measure(record.Index, record.Order, record.Weight);
+                pipe->Applied.store(pipe->Applied.load(memory_order_relaxed) + 1, memory_order_release);
+                idle = 0;
+            }
+            else if (pipe->Stop.load(memory_order_acquire)) {
+                //records pushed before Stop are visible now
+                if (pipe->Ring.IsEmpty())
+                    break;
+            }
+            //spin for a while, then sleep, so that an empty ring does not keep the cpu busy
+            else if (++idle < 64)
+                this_thread::yield();
+            else
+                this_thread::sleep_for(chrono::microseconds(100));
+        }
+    });
+    PinPipeline(*_Pipeline, CPUs);
+    LOG_INFO("Sigma/Polar measurements are applied on a second thread!");
+}
+
+void MarkovMonitor::StopPipeline()
+{
+    if (_Pipeline == nullptr)
+        return;
+    _Pipeline->Stop.store(true, memory_order_release);
+    _Pipeline->Consumer.join();
+    UnpinPipeline(*_Pipeline);
+    delete _Pipeline;
+    _Pipeline = nullptr;
+}
+
+void MarkovMonitor::Flush()
 {
+    if (_Pipeline == nullptr)
+        return;
+    while (_Pipeline->Applied.load(memory_order_acquire) != _Pipeline->Pushed)
+        this_thread::yield();
+}
+
+void MarkovMonitor::_Measure(bool IsSigma, uint Index, int Order, const Amplitude& weight)
+{
+    MeasureRecord record = { Index, Order, IsSigma, weight };
+    while (!_Pipeline->Ring.Push(record))
+        this_thread::yield();
+    _Pipeline->Pushed++;
 }
 
 bool MarkovMonitor::BuildNew(ParaMC &para, Diagram &diag, weight::Weight &weight)
@@ -30,9 +172,11 @@ bool MarkovMonitor::BuildNew(ParaMC &para, Diagram &diag, weight::Weight &weight
     for (int i = 0; i <= Para->Order; i++) {
         WormEstimator.AddEstimator("Order" + ToString(i));
         PhyEstimator.AddEstimator("Order" + ToString(i));
+        MeasureEstimator.AddEstimator("Order" + ToString(i));
     }
     WormEstimator.ClearStatistics();
     PhyEstimator.ClearStatistics();
+    MeasureEstimator.ClearStatistics();
     SigmaEstimator.ClearStatistics();
     PolarEstimator.ClearStatistics();
     return true;
@@ -53,6 +197,7 @@ bool MarkovMonitor::FromDict(const Dictionary &dict, ParaMC &para, Diagram &diag
     for (int i = 0; i <= Para->Order; i++) {
         WormEstimator.AddEstimator("Order" + ToString(i));
         PhyEstimator.AddEstimator("Order" + ToString(i));
+        MeasureEstimator.AddEstimator("Order" + ToString(i));
     }
     bool flag = true;
     flag &= WormEstimator.FromDict(dict.Get<Dictionary>("WormEstimator"),
@@ -63,6 +208,10 @@ bool MarkovMonitor::FromDict(const Dictionary &dict, ParaMC &para, Diagram &diag
                                   );
     flag &= SigmaEstimator.FromDict(dict.Get<Dictionary>("SigmaEstimator"));
     flag &= PolarEstimator.FromDict(dict.Get<Dictionary>("PolarEstimator"));
+    if (dict.HasKey("MeasureEstimator"))
+        flag &= MeasureEstimator.FromDict(dict.Get<Dictionary>("MeasureEstimator"), true);
+    else
+        MeasureEstimator.ClearStatistics();
     return flag;
 }
 Dictionary MarkovMonitor::ToDict()
@@ -72,20 +221,68 @@ Dictionary MarkovMonitor::ToDict()
     dict["PhyEstimator"] = PhyEstimator.ToDict();
     dict["SigmaEstimator"] = SigmaEstimator.ToDict();
     dict["PolarEstimator"] = PolarEstimator.ToDict();
+    dict["MeasureEstimator"] = MeasureEstimator.ToDict();
+    if (Chain != nullptr) {
+        dict["Rejections"] = Chain->RejectionToDict();
+        auto cost = Chain->UpdateCostToDict();
+        if (!cost.IsEmpty())
+            dict["UpdateCost"] = cost;
+    }
     return dict;
 }
 
 void MarkovMonitor::SqueezeStatistics(real factor)
 {
+    Flush();
     Weight->Sigma->Estimator.SqueezeStatistics(factor);
     Weight->Polar->Estimator.SqueezeStatistics(factor);
     WormEstimator.SqueezeStatistics(factor);
     PhyEstimator.SqueezeStatistics(factor);
     SigmaEstimator.SqueezeStatistics(factor);
     PolarEstimator.SqueezeStatistics(factor);
+    MeasureEstimator.SqueezeStatistics(factor);
+}
+
+void MarkovMonitor::MergeStatistics(const MarkovMonitor &source)
+{
+    WormEstimator.MergeStatistics(source.WormEstimator);
+    PhyEstimator.MergeStatistics(source.PhyEstimator);
+    MeasureEstimator.MergeStatistics(source.MeasureEstimator);
+    SigmaEstimator.MergeStatistics(source.SigmaEstimator);
+    PolarEstimator.MergeStatistics(source.PolarEstimator);
+}
+
+void MarkovMonitor::ClearStatistics()
+{
+    WormEstimator.ClearStatistics();
+    PhyEstimator.ClearStatistics();
+    MeasureEstimator.ClearStatistics();
+    SigmaEstimator.ClearStatistics();
+    PolarEstimator.ClearStatistics();
+}
+
+//every adjustment moves a reweight factor by (target/current)^ReWeightDamping, at most by MaxReWeightStep
+const real ReWeightDamping = 0.5;
+const real MaxReWeightStep = 2.0;
+//timed updates needed before the cost of a sector is trusted
+const real MinTimedSteps = 100.0;
+
+real DampedStep(real ratio)
+{
+    return min(max(pow(ratio, ReWeightDamping), 1.0 / MaxReWeightStep), MaxReWeightStep);
 }
 
 bool MarkovMonitor::AdjustOrderReWeight()
+{
+    if (Para->CostReWeight && Chain != nullptr)
+        return _ReWeightByCost();
+    return _ReWeightByCount();
+}
+
+/**
+*  Make every order visited as often as order 0, up to OrderTimeRatio, with the number of configurations of each order.
+*/
+bool MarkovMonitor::_ReWeightByCount()
 {
     for (int i = 0; i <= Para->Order; i++) {
         if (PhyEstimator[i].Norm() < 1000.0)
@@ -96,7 +293,7 @@ bool MarkovMonitor::AdjustOrderReWeight()
     if (Zero(PolarEstimator.Value()) || Zero(SigmaEstimator.Value()))
         return false;
 
-    real weight[Para->Order + 1];
+    real weight[MAX_ORDER];
     real wormweight = 0.0, phyweight = 0.0;
     weight[0] = WormEstimator[0].Value() + PhyEstimator[0].Value();
 
@@ -124,6 +321,109 @@ bool MarkovMonitor::AdjustOrderReWeight()
     return true;
 }
 
+/**
+*  Retune OrderReWeight, WormSpaceReweight and PolarReweight with the cost of the updates measured by Chain
+*  and the error bars of the Sigma/Polar measurements of each order.
+*
+*  A physical diagram of order i is visited N_i ~ R_i*A_i times, A_i being the sum of |weight| of the order,
+*  so the variance of the order i contribution to Sigma/Polar is ~A_i/R_i. Minimizing sum_i OrderTimeRatio[i]*A_i/R_i
+*  at fixed CPU time sum_i c_i*R_i*A_i, with c_i the cycles per update at order i, gives R_i ~ sqrt(OrderTimeRatio[i]/c_i).
+*
+*  The sign makes the variance larger than A_i/R_i, so the orders with an error bar E_i (from MeasureEstimator)
+*  share the CPU time this rule gives them again: with T_i the CPU time of order i, E_i^2 ~ 1/T_i, and the total
+*  variance at fixed sum_i T_i is minimal for new T_i ~ E_i*sqrt(T_i).
+*
+*  Sigma and Polar get the same relative weight, so their number of samples goes as 1/sqrt(cost), and the worm space
+*  gets the same CPU time as the physical space. Orders without enough timed updates keep their reweight factors.
+*/
+real MarkovMonitor::OrderError(int order)
+{
+    if (order == 0)
+        return 0.0;
+    return sqrt(max(Para->OrderTimeRatio[order], 0.0)) * MeasureEstimator[order].Norm() * MeasureEstimator[order].Estimate().Error;
+}
+
+void mc::ReWeightOrders(ParaMC& Para, const real* cycles, const real* steps, const real* error, ostream& output)
+{
+    //the target of the cost rule, and the CPU time it gives to the orders with an error bar
+    real target[MAX_ORDER];
+    real cost0 = cycles[0] / steps[0];
+    real costTime = 0.0, errorTime = 0.0, totalError = 0.0;
+    for (int i = 1; i <= Para.Order; i++) {
+        totalError += error[i];
+        target[i] = 0.0;
+        if (steps[i] < MinTimedSteps || Para.OrderTimeRatio[i] <= 0.0)
+            continue;
+        target[i] = Para.OrderReWeight[0] * sqrt(Para.OrderTimeRatio[i] / Para.OrderTimeRatio[0] * cost0 * steps[i] / cycles[i]);
+        if (error[i] > 0.0) {
+            costTime += cycles[i] * target[i] / Para.OrderReWeight[i];
+            errorTime += error[i] * sqrt(cycles[i]);
+        }
+    }
+
+    output << "Order: cycles/update, error share => reweight" << endl;
+    output << "Order0: " << cost0 << ", 0 => " << Para.OrderReWeight[0] << endl;
+    for (int i = 1; i <= Para.Order; i++) {
+        if (target[i] > 0.0) {
+            if (error[i] > 0.0)
+                target[i] = Para.OrderReWeight[i] * costTime / errorTime * error[i] / sqrt(cycles[i]);
+            Para.OrderReWeight[i] *= DampedStep(target[i] / Para.OrderReWeight[i]);
+        }
+        output << "Order" << i << ": " << (steps[i] > 0.0 ? cycles[i] / steps[i] : 0.0) << ", "
+               << (totalError > 0.0 ? error[i] / totalError : 0.0) << " => " << Para.OrderReWeight[i] << endl;
+    }
+}
+
+bool MarkovMonitor::_ReWeightByCost()
+{
+    Markov& chain = *Chain;
+    real cycles[MAX_ORDER], steps[MAX_ORDER];
+    real wormCycles = 0.0, phyCycles = 0.0;
+    real sigmaCycles = 0.0, sigmaSteps = 0.0, polarCycles = 0.0, polarSteps = 0.0;
+    for (int i = 0; i <= Para->Order; i++) {
+        cycles[i] = steps[i] = 0.0;
+        for (bool IsWorm : { false, true })
+            for (bool IsMeasureG : { false, true }) {
+                if (IsWorm && i == 0)
+                    continue;
+                int sector = chain._Sector(IsWorm, i, IsMeasureG);
+                real c = chain.SectorCycles[sector][i], n = chain.SectorSteps[sector][i];
+                cycles[i] += c;
+                steps[i] += n;
+                if (IsWorm)
+                    wormCycles += c;
+                else {
+                    phyCycles += c;
+                    (IsMeasureG ? sigmaCycles : polarCycles) += c;
+                    (IsMeasureG ? sigmaSteps : polarSteps) += n;
+                }
+            }
+    }
+    if (steps[0] < MinTimedSteps) {
+        LOG_INFO("Order 0 is not visited enough to measure its cost, adjust later.");
+        return false;
+    }
+
+    real error[MAX_ORDER];
+    for (int i = 0; i <= Para->Order; i++)
+        error[i] = OrderError(i);
+    stringstream output;
+    ReWeightOrders(*Para, cycles, steps, error, output);
+
+    if (wormCycles > 0.0 && phyCycles > 0.0) {
+        Para->WormSpaceReweight *= DampedStep(phyCycles / wormCycles);
+        output << "Worm cycles: " << wormCycles << " Physics cycles: " << phyCycles << " => " << Para->WormSpaceReweight << endl;
+    }
+    if (sigmaSteps >= MinTimedSteps && polarSteps >= MinTimedSteps) {
+        real target = sqrt((sigmaCycles / sigmaSteps) / (polarCycles / polarSteps));
+        Para->PolarReweight *= DampedStep(target * sigmaSteps / polarSteps);
+        output << "Sigma updates: " << sigmaSteps << " Polar updates: " << polarSteps << " => " << Para->PolarReweight << endl;
+    }
+    LOG_INFO(output.str());
+    chain.ClearCost();
+    return true;
+}
+
 void MarkovMonitor::Measure()
 {
     real OrderReWeight = Para->OrderReWeight[Diag->Order];
@@ -138,6 +438,8 @@ void MarkovMonitor::Measure()
     else {
         real OrderWeight = 1.0 / OrderReWeight;
         PhyEstimator[Diag->Order].Measure(OrderWeight);
+        if (Para->CostReWeight && Diag->Order > 0)
+            MeasureEstimator[Diag->Order].Measure((Diag->MeasureGLine ? 1.0 : -1.0) * RealPart(Diag->Phase) * OrderWeight);
         if (Diag->MeasureGLine) {
             SigmaEstimator.Measure(OrderWeight);
             if (Diag->Order == 0) {
@@ -147,7 +449,13 @@ void MarkovMonitor::Measure()
                 gLine g = Diag->GMeasure;
                 vertex vin = g->NeighVer(OUT);
                 vertex vout = g->NeighVer(IN);
-                Weight->Sigma->Measure(vin->R, vout->R, vin->Tau, vout->Tau, g->Spin(OUT), g->Spin(IN), Diag->Order, Diag->Phase * OrderWeight);
+                if (_Pipeline != nullptr) {
+                    uint index = Weight->Sigma->MeasureIndex(vin->R, vout->R, vin->Tau, vout->Tau, g->Spin(OUT), g->Spin(IN));
+                    int factor = Weight->Sigma->TauSymmetryFactor(vin->Tau, vout->Tau);
+                    _Measure(true, index, Diag->Order, Diag->Phase * OrderWeight * factor);
+                }
+                else
+                    Weight->Sigma->Measure(vin->R, vout->R, vin->Tau, vout->Tau, g->Spin(OUT), g->Spin(IN), Diag->Order, Diag->Phase * OrderWeight);
             }
         }
         else {
@@ -158,7 +466,12 @@ void MarkovMonitor::Measure()
                 wLine w = Diag->WMeasure;
                 vertex vin = w->NeighVer(OUT);
                 vertex vout = w->NeighVer(IN);
-                Weight->Polar->Measure(vin->R, vout->R, vin->Tau, vout->Tau, vin->Spin(), vout->Spin(), Diag->Order, -Diag->Phase * OrderWeight);
+                if (_Pipeline != nullptr) {
+                    uint index = Weight->Polar->MeasureIndex(vin->R, vout->R, vin->Tau, vout->Tau, vin->Spin(), vout->Spin());
+                    _Measure(false, index, Diag->Order, -Diag->Phase * OrderWeight);
+                }
+                else
+                    Weight->Polar->Measure(vin->R, vout->R, vin->Tau, vout->Tau, vin->Spin(), vout->Spin(), Diag->Order, -Diag->Phase * OrderWeight);
             }
         }
     }
@@ -166,4 +479,6 @@ void MarkovMonitor::Measure()
 
 void MarkovMonitor::AddStatistics()
 {
+    if (Para->CostReWeight)
+        MeasureEstimator.AddStatistics();
 }
@@ -19,16 +19,23 @@ class ParaMC;
 }
 
 namespace mc {
+class Markov;
+class MeasurePipeline;
 class MarkovMonitor {
   public:
     MarkovMonitor();
+    ~MarkovMonitor();
 
     para::ParaMC *Para;
     diag::Diagram *Diag;
     weight::Weight *Weight;
+    //the chain whose update costs are saved with the statistics
+    Markov *Chain;
 
     EstimatorBundle<real> WormEstimator;
     EstimatorBundle<real> PhyEstimator;
+    //signed Sigma/Polar measurements of each order, whose error bars steer ParaMC::CostReWeight
+    EstimatorBundle<real> MeasureEstimator;
     Estimator<real> SigmaEstimator, PolarEstimator;
 
     bool BuildNew(para::ParaMC &, diag::Diagram &, weight::Weight &);
@@ -37,10 +44,32 @@ class MarkovMonitor {
 
     void Reset(para::ParaMC &, diag::Diagram &, weight::Weight &);
     void SqueezeStatistics(real factor);
+    //add the Worm/Phy/Measure/Sigma/Polar estimators of the monitor of another chain, clear them with ClearStatistics
+    void MergeStatistics(const MarkovMonitor &);
+    void ClearStatistics();
     bool AdjustOrderReWeight();
+    //error bar of the Sigma/Polar contribution of an order, weighted by OrderTimeRatio
+    real OrderError(int order);
     void Measure();
     void AddStatistics();
+
+    //Measure() only pushes Sigma/Polar measurements into a ring, a second thread adds them to the estimators;
+    //the Markov thread is pinned on CPUs[0] and the second thread on CPUs[1] until StopPipeline, if they are given
+    void StartPipeline(const std::vector<int> &CPUs = std::vector<int>());
+    void StopPipeline();
+    //wait until all pushed measurements are added, call it before the Sigma/Polar estimators are read or changed
+    void Flush();
+
+  private:
+    MeasurePipeline *_Pipeline;
+    bool _ReWeightByCount();
+    bool _ReWeightByCost();
+    void _Measure(bool IsSigma, uint Index, int Order, const Amplitude &);
 };
+
+//retune OrderReWeight of the orders above 0 with the cycles, timed updates and error bar of each order,
+//see MarkovMonitor::AdjustOrderReWeight with ParaMC::CostReWeight
+void ReWeightOrders(para::ParaMC &, const real *cycles, const real *steps, const real *error, std::ostream &);
 }
 
 #endif /* defined(__Feynman_Simulator__measure__) */
@@ -6,41 +6,68 @@
 //  Copyright (c) 2014 Kun Chen. All rights reserved.
 //
 
-#include "markov.h"
+#include "markov_test.h"
+#include "markov_walkers.h"
 #include "utility/sput.h"
-#include "module/diagram/diagram.h"
-#include "module/weight/weight.h"
 #include "module/weight/component.h"
-#include "module/parameter/parameter.h"
+#include "utility/dictionary.h"
+#include <string.h>
+#include <sstream>
 using namespace std;
 using namespace mc;
 
 void Test_Updates();
+void Test_Walkers();
+void Test_Pipeline();
+void Test_ReWeight();
+void Test_ErrorReWeight();
+void Test_Range();
+void Test_StaleUpdateWeight();
 
 int mc::TestMarkov()
 {
     sput_start_testing();
     sput_enter_suite("Test Updates:");
     sput_run_test(Test_Updates);
+    sput_run_test(Test_Walkers);
+    sput_run_test(Test_Pipeline);
+    sput_run_test(Test_ReWeight);
+    sput_run_test(Test_ErrorReWeight);
+    sput_run_test(Test_Range);
+    sput_run_test(Test_StaleUpdateWeight);
     sput_finish_testing();
     return sput_get_return_value();
 }
 
-void Test_Updates()
+TestChain::TestChain()
+    : Weight(true)
 {
-    para::ParaMC Para;
     Para.SetTest();
-    weight::Weight Weight(true);
+    Para.RNG.Reset(Para.Seed);
+}
+
+void TestChain::Build(std::function<void(weight::Weight&)> OnWeight)
+{
     Weight.SetTest(Para);
-    diag::Diagram Diag;
+    if (OnWeight)
+        OnWeight(Weight);
     Diag.SetTest(Para.Lat, *Weight.G, *Weight.W);
-    Markov markov;
-    markov.BuildNew(Para, Diag, Weight);
+    Chain.BuildNew(Para, Diag, Weight);
+    Monitor.BuildNew(Para, Diag, Weight);
+    Monitor.Chain = &Chain;
+}
+
+void Test_Updates()
+{
+    TestChain Test;
+    Test.Build();
+    auto& Diag = Test.Diag;
+    auto& markov = Test.Chain;
 
     //    Para.RNG.Reset(100);
     system("mkdir diagram");
     sput_fail_unless(Diag.CheckDiagram(), "Check diagram G,W,Ver and Weight");
-    sput_fail_if(Equal(Diag.Weight, Complex(0.0, 0.0)), "Initialize diagram has nonzero weight");
+    sput_fail_if(Equal(Diag.Weight, Amplitude(0.0)), "Initialize diagram has nonzero weight");
     for (int i = 0; i < 100; i++) {
         markov.Hop(5000);
 
@@ -50,3 +77,143 @@ void Test_Updates()
     }
     LOG_INFO("Updates Check are done!");
 }
+
+void Test_Walkers()
+{
+    TestChain Test;
+    Test.Build();
+    MarkovWalkers Walkers;
+    Walkers.BuildNew(Test.Para, Test.Diag, Test.Weight);
+
+    bool flag = true;
+    for (int i = 0; i < 10; i++) {
+        Walkers.Hop(5000);
+        for (int l = 0; l < WALKER_LANES; l++)
+            flag &= Walkers.Diag(l).CheckDiagram();
+    }
+    sput_fail_unless(flag, "Check the diagrams of all walkers after lock-step updates");
+}
+
+bool SameAccu(weight::WeightEstimator& e1, weight::WeightEstimator& e2)
+{
+    auto arr1 = e1.ToDict().Get<Python::ArrayObject>("WeightAccu");
+    auto arr2 = e2.ToDict().Get<Python::ArrayObject>("WeightAccu");
+    return arr1.Size() == arr2.Size() && memcmp(arr1.Data<Complex>(), arr2.Data<Complex>(), arr1.Size() * sizeof(Complex)) == 0;
+}
+
+void Test_Pipeline()
+{
+    TestChain Test[2];
+    for (int i = 0; i < 2; i++)
+        Test[i].Build();
+    //the ring keeps the order of measurements, so the sums agree bit by bit
+    Test[1].Monitor.StartPipeline();
+    for (int step = 0; step < 20000; step++)
+        for (int i = 0; i < 2; i++) {
+            Test[i].Chain.Hop(10);
+            Test[i].Monitor.Measure();
+        }
+    Test[1].Monitor.Flush();
+    sput_fail_unless(SameAccu(Test[0].Weight.Sigma->Estimator, Test[1].Weight.Sigma->Estimator), "Sigma accumulated on the pipeline thread");
+    sput_fail_unless(SameAccu(Test[0].Weight.Polar->Estimator, Test[1].Weight.Polar->Estimator), "Polar accumulated on the pipeline thread");
+    Test[1].Monitor.StopPipeline();
+}
+
+void Test_ReWeight()
+{
+    TestChain Test;
+    Test.Para.CostReWeight = true;
+    Test.Build();
+    auto& Para = Test.Para;
+    auto& markov = Test.Chain;
+    auto& Monitor = Test.Monitor;
+    vector<real> old = Para.OrderReWeight;
+    //order 0 is rarely visited on larger lattices, so hop until its cost is known
+    bool adjusted = false;
+    for (int round = 0; round < 20 && !adjusted; round++) {
+        for (int step = 0; step < 10000; step++) {
+            markov.Hop(10);
+            Monitor.Measure();
+        }
+        adjusted = Monitor.AdjustOrderReWeight();
+    }
+    sput_fail_unless(adjusted, "Adjust reweight factors with the measured cost");
+    bool flag = true;
+    for (int i = 0; i <= Para.Order; i++)
+        flag &= (Para.OrderReWeight[i] >= old[i] / 2.0 - eps0 && Para.OrderReWeight[i] <= old[i] * 2.0 + eps0);
+    sput_fail_unless(flag, "Reweight factors only move by a damped step");
+}
+
+void Test_ErrorReWeight()
+{
+    TestChain Test;
+    Test.Para.CostReWeight = true;
+    Test.Build();
+    auto& Para = Test.Para;
+    auto& Monitor = Test.Monitor;
+    //order 1 and 2 are measured equally often, but the measurements of order 2 fluctuate more
+    for (int bin = 0; bin < 1000; bin++) {
+        for (int step = 0; step < 100; step++) {
+            real noise = Para.RNG.urn() - 0.5;
+            Monitor.MeasureEstimator[1].Measure(1.0 + 0.1 * noise);
+            Monitor.MeasureEstimator[2].Measure(1.0 + 0.4 * noise);
+        }
+        Monitor.AddStatistics();
+    }
+    real error[MAX_ORDER];
+    for (int i = 0; i <= Para.Order; i++)
+        error[i] = Monitor.OrderError(i);
+    sput_fail_unless(error[2] > error[1] && error[1] > 0.0, "The noisier order has the larger error bar");
+
+    //every order costs the same
+    real cycles[MAX_ORDER], steps[MAX_ORDER];
+    for (int i = 0; i <= Para.Order; i++) {
+        cycles[i] = 1.0e6;
+        steps[i] = 1.0e4;
+    }
+    vector<real> old = Para.OrderReWeight;
+    stringstream output;
+    ReWeightOrders(Para, cycles, steps, error, output);
+    sput_fail_unless(Para.OrderReWeight[2] > Para.OrderReWeight[1] && Equal(old[1], old[2]),
+                     "Orders of the same cost get more weight for a larger error bar");
+}
+
+void Test_Range()
+{
+    TestChain Test;
+    //the test W vanishes at most site pairs, which are then out of the range
+    Test.Para.WThreshold = 0.0;
+    Test.Build([](weight::Weight& Weight) { Weight.W->FromDict(Weight.W->ToDict()); });
+    auto& Para = Test.Para;
+    auto& Weight = Test.Weight;
+    auto& markov = Test.Chain;
+    Site o(0, Vec<int>(0));
+    int NInRange = 0;
+    for (int r = 0; r < Para.Lat.Vol; r++)
+        NInRange += Weight.W->IsInRange(o, Site(0, Para.Lat.Index2Vec(r)));
+    sput_fail_unless(Weight.W->IsInRange(o, o) && NInRange < Para.Lat.Vol, "W is kept only where it does not vanish");
+    bool flag = true;
+    for (int i = 0; i < 10; i++) {
+        markov.Hop(5000);
+        flag &= markov.Diag->CheckDiagram() && !Equal(markov.Diag->Weight, Amplitude(0.0));
+    }
+    sput_fail_unless(flag, "Check the diagram with the range of W");
+}
+
+void Test_StaleUpdateWeight()
+{
+    TestChain Test[2];
+    //a table frozen while the updates were disabled, like ChangeROnVertex in older runs
+    Test[1].Para.UpdateWeight.assign(NUpdates, 0.0);
+    for (int i = 0; i < 2; i++)
+        Test[i].Build();
+    sput_fail_unless(Test[1].Para.UpdateWeight.empty(), "A table disabling an enabled update is not reused");
+    for (int i = 0; i < 2; i++) {
+        Test[i].Chain.Hop(100000);
+        Test[i].Chain.TuneUpdateWeight();
+    }
+    bool flag = int(Test[1].Para.UpdateWeight.size()) == NUpdates;
+    for (int op = 0; flag && op < NUpdates; op++)
+        flag &= (Test[0].Para.UpdateWeight[op] > 0.0) == (Test[1].Para.UpdateWeight[op] > 0.0);
+    sput_fail_unless(flag, "The table is tuned again with the updates of a new run");
+}
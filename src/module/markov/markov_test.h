@@ -0,0 +1,35 @@
+//
+//  markov_test.h
+//  Feynman_Simulator
+//
+
+#ifndef __Feynman_Simulator__markov_test__
+#define __Feynman_Simulator__markov_test__
+
+#include "markov.h"
+#include "markov_monitor.h"
+#include "module/diagram/diagram.h"
+#include "module/weight/weight.h"
+#include "module/parameter/parameter.h"
+#include <functional>
+
+namespace mc {
+/**
+*  A Markov chain and its monitor built from ParaMC::SetTest, Weight::SetTest and Diagram::SetTest,
+*  so that tests and benchmarks need no input file.
+*  Para may be changed between the constructor and Build; OnWeight, if given, is called on the
+*  weights before the diagram is built on them.
+*/
+class TestChain {
+public:
+    TestChain();
+    void Build(std::function<void(weight::Weight&)> OnWeight = nullptr);
+
+    para::ParaMC Para;
+    weight::Weight Weight;
+    diag::Diagram Diag;
+    Markov Chain;
+    MarkovMonitor Monitor;
+};
+}
+#endif /* defined(__Feynman_Simulator__markov_test__) */
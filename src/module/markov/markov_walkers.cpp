@@ -0,0 +1,200 @@
+//
+//  markov_walkers.cpp
+//  Feynman_Simulator
+//
+
+#include "markov_walkers.h"
+#include "module/diagram/diagram.h"
+#include "module/weight/weight.h"
+#include "module/weight/component.h"
+#include "utility/dictionary.h"
+#include <climits>
+using namespace std;
+using namespace diag;
+using namespace mc;
+
+MarkovWalkers::MarkovWalkers()
+{
+    LockStepShare = 0.5;
+    G = nullptr;
+    W = nullptr;
+    for (int l = 0; l < WALKER_LANES; l++) {
+        _Diag[l] = nullptr;
+        _Chain[l] = nullptr;
+    }
+}
+
+MarkovWalkers::~MarkovWalkers()
+{
+    for (int l = 0; l < WALKER_LANES; l++) {
+        delete _Chain[l];
+        delete _Diag[l];
+    }
+}
+
+bool MarkovWalkers::BuildNew(para::ParaMC& para, Diagram& diag, weight::Weight& weight)
+{
+    G = weight.G;
+    W = weight.W;
+    _RNG.Reset(para.RNG.irn(0, INT_MAX - 1));
+    Dictionary Config = diag.ToDict();
+    for (int l = 0; l < WALKER_LANES; l++) {
+        _Para[l] = para;
+        _Para[l].Counter = 0;
+        _Para[l].RNG.Reset(para.RNG.irn(0, INT_MAX - 1));
+        delete _Chain[l];
+        delete _Diag[l];
+        _Diag[l] = new Diagram;
+        _Diag[l]->FromDict(Config, _Para[l].Lat, *G, *W);
+        _Chain[l] = new Markov;
+        _Chain[l]->BuildNew(_Para[l], *_Diag[l], weight);
+    }
+    return true;
+}
+
+Diagram& MarkovWalkers::Diag(int walker)
+{
+    return *_Diag[walker];
+}
+
+Markov& MarkovWalkers::Chain(int walker)
+{
+    return *_Chain[walker];
+}
+
+/**
+*  every walker makes sweep updates
+*/
+void MarkovWalkers::Hop(int sweep)
+{
+    for (int i = 0; i < sweep; i++) {
+        if (_RNG.urn() < LockStepShare)
+            ChangeTauOnVertex();
+        else
+            for (int l = 0; l < WALKER_LANES; l++)
+                _Chain[l]->Hop(1);
+    }
+}
+
+/**
+*  Markov::ChangeTauOnVertex with one candidate, for all walkers at once: pick the vertex and
+*  propose its Tau in every lane, look up the new lines of all lanes together, compute the weight
+*  ratios lane by lane, then write the accepted lanes back into their diagrams.
+*  Lanes which can not make the update are masked, and look up harmless dummy lines.
+*/
+void MarkovWalkers::ChangeTauOnVertex()
+{
+    const int N = WALKER_LANES;
+    vertex ver[N];
+    gLine gin[N], gout[N];
+    wLine w[N];
+    bool active[N], tadpole[N], IsMeasureG[2 * N], IsMeasureW[N];
+    //G lines into the vertex in [0, N), out of it in [N, 2N)
+    uint BaseG[2 * N], BaseW[N];
+    real tinG[2 * N], toutG[2 * N], tinW[N], toutW[N], tau[N];
+    real oldRe[N], oldIm[N], probTau[N], u[N];
+
+    for (int l = 0; l < N; l++) {
+        Markov& chain = *_Chain[l];
+        Diagram& diag = *_Diag[l];
+        active[l] = false;
+        tadpole[l] = true;
+        BaseG[l] = BaseG[N + l] = BaseW[l] = 0;
+        tinG[l] = toutG[l] = tinG[N + l] = toutG[N + l] = tinW[l] = toutW[l] = 0.0;
+        IsMeasureG[l] = IsMeasureG[N + l] = IsMeasureW[l] = false;
+        oldRe[l] = 1.0;
+        oldIm[l] = 0.0;
+        probTau[l] = u[l] = 0.0;
+
+        if (diag.Order == 0 || diag.Worm.Exist) {
+            chain._Reject(Markov::CHANGE_TAU_VERTEX, Markov::WRONG_SECTOR);
+            continue;
+        }
+        vertex v = diag.Ver.RandomPick(*chain.RNG);
+        wLine wl = v->NeighW();
+        if (wl->IsDelta) {
+            chain._Reject(Markov::CHANGE_TAU_VERTEX, Markov::DELTA_LINE);
+            continue;
+        }
+        gLine gi = v->NeighG(IN), go = v->NeighG(OUT);
+        vertex vIn = gi->NeighVer(IN), vOut = go->NeighVer(OUT);
+        active[l] = true;
+        tadpole[l] = (gi == go);
+        ver[l] = v;
+        gin[l] = gi;
+        gout[l] = go;
+        w[l] = wl;
+
+        real probNew, probOld;
+        if (tadpole[l]) {
+            tau[l] = chain.RandomPickTau();
+            probNew = chain.ProbTau(tau[l]);
+            probOld = chain.ProbTau(v->Tau);
+        }
+        else {
+            spin s = gi->Spin();
+            tau[l] = chain.RandomPickTau(vIn->Tau, OUT, s, vIn->R.Sublattice, v->R.Sublattice);
+            probNew = chain.ProbTau(tau[l], vIn->Tau, OUT, s, vIn->R.Sublattice, v->R.Sublattice);
+            probOld = chain.ProbTau(v->Tau, vIn->Tau, OUT, s, vIn->R.Sublattice, v->R.Sublattice);
+        }
+        probTau[l] = probOld / probNew;
+
+        BaseG[l] = G->BaseIndex(vIn->R, v->R, vIn->Spin(OUT), v->Spin(IN));
+        tinG[l] = (tadpole[l] ? tau[l] : vIn->Tau);
+        toutG[l] = tau[l];
+        IsMeasureG[l] = gi->IsMeasure;
+        BaseG[N + l] = G->BaseIndex(v->R, vOut->R, v->Spin(OUT), vOut->Spin(IN));
+        tinG[N + l] = tau[l];
+        toutG[N + l] = (tadpole[l] ? tau[l] : vOut->Tau);
+        IsMeasureG[N + l] = go->IsMeasure;
+
+        vertex wIn = wl->NeighVer(IN), wOut = wl->NeighVer(OUT);
+        BaseW[l] = W->BaseIndex(wIn->R, wOut->R, wIn->Spin(), wOut->Spin());
+        tinW[l] = (wIn == v ? tau[l] : wIn->Tau);
+        toutW[l] = (wOut == v ? tau[l] : wOut->Tau);
+        IsMeasureW[l] = wl->IsMeasure;
+
+        Amplitude oldWeight = (tadpole[l] ? gi->Weight * wl->Weight : gi->Weight * go->Weight * wl->Weight);
+        oldRe[l] = RealPart(oldWeight);
+        oldIm[l] = ImagPart(oldWeight);
+        u[l] = chain.RNG->urn();
+    }
+
+    real gRe[2 * N], gIm[2 * N], wRe[N], wIm[N];
+    G->Weight(2 * N, BaseG, tinG, toutG, IsMeasureG, gRe, gIm);
+    W->Weight(N, BaseW, tinW, toutW, IsMeasureW, wRe, wIm);
+
+    real ratioRe[N], ratioIm[N];
+    bool accept[N];
+    for (int l = 0; l < N; l++) {
+        //a tadpole has only one G line
+        real goutRe = (tadpole[l] ? 1.0 : gRe[N + l]), goutIm = (tadpole[l] ? 0.0 : gIm[N + l]);
+        real gRe2 = gRe[l] * goutRe - gIm[l] * goutIm, gIm2 = gRe[l] * goutIm + gIm[l] * goutRe;
+        real newRe = gRe2 * wRe[l] - gIm2 * wIm[l], newIm = gRe2 * wIm[l] + gIm2 * wRe[l];
+        real norm = oldRe[l] * oldRe[l] + oldIm[l] * oldIm[l];
+        ratioRe[l] = (newRe * oldRe[l] + newIm * oldIm[l]) / norm;
+        ratioIm[l] = (newIm * oldRe[l] - newRe * oldIm[l]) / norm;
+        real prob = sqrt(ratioRe[l] * ratioRe[l] + ratioIm[l] * ratioIm[l]) * probTau[l];
+        accept[l] = active[l] && u[l] < prob;
+    }
+
+    for (int l = 0; l < N; l++) {
+        if (!active[l])
+            continue;
+        Markov& chain = *_Chain[l];
+        Diagram& diag = *_Diag[l];
+        chain.Proposed[Markov::CHANGE_TAU_VERTEX][diag.Order] += 1.0;
+        if (!accept[l])
+            continue;
+        chain.Accepted[Markov::CHANGE_TAU_VERTEX][diag.Order] += 1.0;
+        Amplitude weightRatio = ToAmplitude(ratioRe[l], ratioIm[l]);
+        diag.Phase *= phase(weightRatio);
+        diag.Weight *= weightRatio;
+
+        ver[l]->Tau = tau[l];
+        gin[l]->Weight = ToAmplitude(gRe[l], gIm[l]);
+        if (!tadpole[l])
+            gout[l]->Weight = ToAmplitude(gRe[N + l], gIm[N + l]);
+        w[l]->Weight = ToAmplitude(wRe[l], wIm[l]);
+    }
+}
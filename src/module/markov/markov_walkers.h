@@ -0,0 +1,49 @@
+//
+//  markov_walkers.h
+//  Feynman_Simulator
+//
+
+#ifndef __Feynman_Simulator__markov_walkers__
+#define __Feynman_Simulator__markov_walkers__
+
+#include "markov.h"
+#include "module/parameter/parameter.h"
+
+namespace mc {
+//walkers advanced in lock step, one per SIMD lane (8 doubles for AVX-512, two AVX2 registers)
+const int WALKER_LANES = 8;
+
+/**
+*  Experimental engine which advances WALKER_LANES walkers, each with its own diagram, Markov chain
+*  and random number stream, on the same G/W.
+*  In a lock-step step all walkers change Tau on a vertex together: the lines are looked up and
+*  the complex weight ratios, modules and accept masks are computed lane by lane in structure-of-arrays
+*  loops the compiler can vectorize. The other steps fall back to one scalar Markov::Hop per walker.
+*  Both kinds of steps keep the distribution of every walker, so their mixture does as well.
+*/
+class MarkovWalkers {
+public:
+    MarkovWalkers();
+    ~MarkovWalkers();
+
+    //probability of a lock-step step instead of a scalar one
+    real LockStepShare;
+
+    //every walker starts from a copy of diag, with a random number stream seeded by para.RNG
+    bool BuildNew(para::ParaMC& para, diag::Diagram& diag, weight::Weight& weight);
+    void Hop(int sweep);
+    void ChangeTauOnVertex();
+
+    diag::Diagram& Diag(int walker);
+    Markov& Chain(int walker);
+
+private:
+    RandomFactory _RNG;
+    para::ParaMC _Para[WALKER_LANES];
+    diag::Diagram* _Diag[WALKER_LANES];
+    Markov* _Chain[WALKER_LANES];
+    weight::GClass* G;
+    weight::WClass* W;
+};
+}
+#endif /* defined(__Feynman_Simulator__markov_walkers__) */
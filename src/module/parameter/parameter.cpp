@@ -41,6 +41,13 @@ bool Parameter::_FromDict(const Dictionary& Para)
     L = Vec<int>(Lnew.data());
 
     Lat.Initialize(L, NSublat);
+    GET_WITH_DEFAULT(_para, PointGroup, false);
+    if (PointGroup) {
+        _para.Get("Name", LatticeName);
+        Lat.SetPointGroup(LatticeName);
+    }
+    GET_WITH_DEFAULT(_para, WCutoff, -1.0);
+    GET_WITH_DEFAULT(_para, WThreshold, -1.0);
     T = 1.0 / Beta;
 
     return true;
@@ -50,6 +57,11 @@ Dictionary Parameter::_ToDict()
     Dictionary Para, _para;
     SET(_para, L);
     SET(_para, NSublat);
+    SET(_para, PointGroup);
+    if (PointGroup)
+        _para["Name"] = LatticeName;
+    SET(_para, WCutoff);
+    SET(_para, WThreshold);
     Para["Lattice"] = _para;
     _para.Clear();
     SET(_para, Beta);
@@ -75,8 +87,11 @@ bool ParaMC::FromDict(const Dictionary& Para)
     GET(_para, Sweep);
     GET(_para, WormSpaceReweight);
     GET(_para, PolarReweight);
+    GET_WITH_DEFAULT(_para, TauTrials, 1);
     GET(_para, OrderReWeight);
     GET(_para, OrderTimeRatio);
+    GET_WITH_DEFAULT(_para, CostReWeight, false);
+    GET_WITH_DEFAULT(_para, UpdateWeight, std::vector<real>());
     GET(_para, Order);
     GET_WITH_DEFAULT(_para, Counter, 0);
     GET_WITH_DEFAULT(_para, Seed, 0);
@@ -85,7 +100,7 @@ bool ParaMC::FromDict(const Dictionary& Para)
     else
         RNG.Reset(Seed);
     ASSERT_ALLWAYS(Order < MAX_ORDER, "Order can not be bigger than " << MAX_ORDER);
-    ASSERT_ALLWAYS(OrderReWeight.size() >= Order + 1, "OrderReWeight should have Order+1 elementes!");
+    ASSERT_ALLWAYS(int(OrderReWeight.size()) >= Order + 1, "OrderReWeight should have Order+1 elementes!");
 
     auto _timer = _para.Get<Dictionary>("Timer");
     GET(_timer, PrinterTimer);
@@ -101,8 +116,12 @@ Dictionary ParaMC::ToDict()
     SET(_para, Sweep);
     SET(_para, WormSpaceReweight);
     SET(_para, PolarReweight);
+    SET(_para, TauTrials);
     SET(_para, OrderReWeight);
     SET(_para, OrderTimeRatio);
+    SET(_para, CostReWeight);
+    if (!UpdateWeight.empty())
+        SET(_para, UpdateWeight);
     SET(_para, Counter);
     SET(_para, RNG);
     SET(_para, Order);
@@ -121,18 +140,23 @@ Dictionary ParaMC::ToDict()
 void ParaMC::SetTest()
 {
     Version = 0;
-    int size[2] = { 8, 8 };
+    int size[3] = { 8, 8, 8 };
     NSublat = 2;
     L = Vec<int>(size);
     Lat = Lattice(L, NSublat);
+    PointGroup = false;
+    WCutoff = -1.0;
+    WThreshold = -1.0;
     Beta = 0.5;
     Order = 4;
     OrderReWeight = { 1, 1, 1, 1, 1};
     OrderTimeRatio = { 1, 1, 1, 1, 1 };
+    CostReWeight = false;
     Toss = 10000;
     Seed = 519180543;
     WormSpaceReweight = 0.1;
     PolarReweight = 1.0;
+    TauTrials = 4;
     T = 1.0 / Beta;
     Counter = 0;
     MaxTauBin = 32;
@@ -26,6 +26,12 @@ public:
     uint MaxTauBin;
     int Order;
     int NSublat;
+    //store the weights once per class of site pairs related by the point group of the lattice
+    bool PointGroup;
+    std::string LatticeName;
+    //keep W only within WCutoff unit cells or above WThreshold times its largest value, off if negative
+    real WCutoff;
+    real WThreshold;
 
     //derived
     real T;
@@ -50,8 +56,14 @@ public:
     RandomFactory RNG;
     real WormSpaceReweight;
     real PolarReweight;
+    //number of candidate times tried at once by ChangeTauOnVertex
+    int TauTrials;
     std::vector<real> OrderReWeight;
     std::vector<real> OrderTimeRatio;
+    //tune the reweight factors with the measured cost and error of each order, the updates are then timed
+    bool CostReWeight;
+    //relative weight of each Markov update, empty until it is tuned during thermalization
+    std::vector<real> UpdateWeight;
 
     int PrinterTimer;
     int DiskWriterTimer;
@@ -8,6 +8,9 @@
 
 #include "component.h"
 #include "utility/dictionary.h"
+#include "utility/logger.h"
+#include <algorithm>
+#include <math.h>
 #include <tuple>
 
 using namespace weight;
@@ -15,6 +18,159 @@ using namespace std;
 
 real Norm::NormFactor = 1.0;
 
+/**
+*  The arrays of dyson/weight.py have the full layout [SP1, SUB1, SP2, SUB2, VOL, ...] with FullSpin spins on
+*  each end, while a map may store only the conserved spin channels or one element per displacement class.
+*  Outer axes (the order of an estimator) come before SP1, Inner ones (tau) after VOL.
+*/
+template <typename MAP, typename F>
+void ForEachPoint(const MAP& map, F visit)
+{
+    const Lattice& lat = map.Lat;
+    uint full = 0;
+    for (int sp1 = 0; sp1 < MAP::FullSpin; sp1++)
+        for (int sub1 = 0; sub1 < lat.SublatVol; sub1++)
+            for (int sp2 = 0; sp2 < MAP::FullSpin; sp2++)
+                for (int sub2 = 0; sub2 < lat.SublatVol; sub2++)
+                    for (int coord = 0; coord < lat.Vol; coord++)
+                        visit(full++, map.StoredIndex(sp1, sub1, sp2, sub2, coord));
+}
+
+//the shapes of the stored and the full array, and the sizes of the outer axes, the points and the inner axes
+template <typename MAP>
+void Layout(const MAP& map, vector<uint>& stored, vector<uint>& full, uint Outer,
+            uint& NOuter, uint& StoredPoints, uint& FullPoints, uint& Inner)
+{
+    full = stored;
+    std::copy(map.GetShape(), map.GetShape() + VOL + 1, stored.begin() + Outer);
+    full[Outer + SP1] = full[Outer + SP2] = MAP::FullSpin;
+    full[Outer + SUB1] = full[Outer + SUB2] = map.Lat.SublatVol;
+    full[Outer + VOL] = map.Lat.Vol;
+    NOuter = StoredPoints = FullPoints = Inner = 1;
+    for (uint i = 0; i < stored.size(); i++)
+        if (i < Outer)
+            NOuter *= stored[i];
+        else if (i <= Outer + VOL) {
+            StoredPoints *= stored[i];
+            FullPoints *= full[i];
+        }
+        else
+            Inner *= stored[i];
+}
+
+bool IsSymmetric(const Complex& a, const Complex& b)
+{
+    return mod(a - b) <= 1.0e-8 * (mod(a) + mod(b)) + 1.0e-14;
+}
+
+/**
+*  an array of dyson/weight.py in the layout of the map; with Sum (histograms) the points of a displacement
+*  class are added up, otherwise (weights) they have to agree; unconserved spins have to be zero
+*/
+template <typename MAP>
+Python::ArrayObject ToStored(const MAP& map, Python::ArrayObject full, uint Outer, bool Sum)
+{
+    auto shape = full.Shape(), fullshape = shape;
+    uint NOuter, StoredPoints, FullPoints, Inner;
+    ASSERT_ALLWAYS(shape.size() > Outer + VOL, "Shape should match!");
+    Layout(map, shape, fullshape, Outer, NOuter, StoredPoints, FullPoints, Inner);
+    ASSERT_ALLWAYS(fullshape == full.Shape(), "Shape should match!");
+    auto stored = Python::ArrayObject::Zeros(shape);
+    const Complex* source = full.Data<Complex>();
+    Complex* target = stored.Data<Complex>();
+    vector<bool> Visited(StoredPoints, false);
+    ForEachPoint(map, [&](uint f, int s) {
+        for (uint o = 0; o < NOuter; o++) {
+            const Complex* from = source + (o * FullPoints + f) * Inner;
+            //the weights out of the range of the map are dropped
+            if (s == OUT_OF_RANGE)
+                continue;
+            if (s < 0) {
+                for (uint i = 0; i < Inner; i++)
+                    ASSERT_ALLWAYS(IsZero(from[i]), "The spin is not conserved along W, build without SPIN_CONSERVED!");
+                continue;
+            }
+            Complex* to = target + (o * StoredPoints + s) * Inner;
+            for (uint i = 0; i < Inner; i++)
+                if (Sum || !Visited[s])
+                    to[i] += from[i];
+                else
+                    ASSERT_ALLWAYS(IsSymmetric(to[i], from[i]), "The weight is not invariant under the point group, set PointGroup to False!");
+        }
+        if (s >= 0)
+            Visited[s] = true;
+    });
+    return stored;
+}
+
+//the array of dyson/weight.py of an array in the layout of the map; with Sum (histograms) a class is shared by its points
+template <typename MAP>
+Python::ArrayObject ToFull(const MAP& map, Python::ArrayObject stored, uint Outer, bool Sum)
+{
+    auto shape = stored.Shape(), fullshape = shape;
+    uint NOuter, StoredPoints, FullPoints, Inner;
+    Layout(map, shape, fullshape, Outer, NOuter, StoredPoints, FullPoints, Inner);
+    ASSERT_ALLWAYS(shape == stored.Shape(), "Shape should match!");
+    vector<uint> Multiplicity(StoredPoints, 0);
+    ForEachPoint(map, [&](uint, int s) {
+        if (s >= 0)
+            Multiplicity[s]++;
+    });
+    auto full = Python::ArrayObject::Zeros(fullshape);
+    const Complex* source = stored.Data<Complex>();
+    Complex* target = full.Data<Complex>();
+    ForEachPoint(map, [&](uint f, int s) {
+        if (s < 0)
+            return;
+        real factor = Sum ? 1.0 / Multiplicity[s] : 1.0;
+        for (uint o = 0; o < NOuter; o++)
+            for (uint i = 0; i < Inner; i++)
+                target[(o * FullPoints + f) * Inner + i] = source[(o * StoredPoints + s) * Inner + i] * factor;
+    });
+    return full;
+}
+
+//the dictionary with its array Name in the layout of the map, an array in that layout already is kept
+template <typename MAP>
+Dictionary Stored(const MAP& map, Dictionary dict, const string& Name, uint Outer, bool Sum)
+{
+    auto array = dict.Get<Python::ArrayObject>(Name);
+    auto shape = array.Shape();
+    if (shape.size() > Outer + VOL && Equal(shape.data() + Outer, map.GetShape(), VOL + 1))
+        return dict;
+    dict[Name] = ToStored(map, array, Outer, Sum);
+    return dict;
+}
+
+//the dictionary with its array Name in the layout of dyson/weight.py, an array in the layout of the map is expanded
+template <typename MAP>
+Dictionary Full(const MAP& map, Dictionary dict, const string& Name, uint Outer, bool Sum)
+{
+    auto array = dict.Get<Python::ArrayObject>(Name);
+    auto shape = array.Shape();
+    if (shape.size() > Outer + VOL && Equal(shape.data() + Outer, map.GetShape(), VOL + 1))
+        dict[Name] = ToFull(map, array, Outer, Sum);
+    return dict;
+}
+
+//with a point group or a range the arrays are saved in the layout of dyson/weight.py, SPIN_CONSERVED arrays are saved compact otherwise
+template <typename MAP>
+Dictionary Saved(const MAP& map, Dictionary dict, const string& Name, uint Outer, bool Sum)
+{
+    if (map.Lat.HasPointGroup() || map.HasRange())
+        dict[Name] = ToFull(map, dict.Get<Python::ArrayObject>(Name), Outer, Sum);
+    return dict;
+}
+
+template <uint DIM, typename T>
+real MaxAbs(const WeightArray<DIM, T>& array)
+{
+    real max = 0.0;
+    for (uint i = 0; i < array.GetSize(); i++)
+        max = std::max(max, mod(array(i)));
+    return max;
+}
+
 GClass::GClass(const Lattice& lat, real beta, uint MaxTauBin, TauSymmetry Symmetry)
     : _Map(IndexMapSPIN2(beta, MaxTauBin, lat, Symmetry))
 {
@@ -28,12 +184,12 @@ GClass::GClass(const Lattice& lat, real beta, uint MaxTauBin, TauSymmetry Symmet
 void GClass::BuildTest()
 {
     _SmoothTWeight.Assign(0.0);
-    for (uint sub = 0; sub < _Map.Lat.SublatVol; sub++) {
+    for (int sub = 0; sub < _Map.Lat.SublatVol; sub++) {
         Site Local(sub, { 0, 0 });
         for (uint tau = 0; tau < _Map.MaxTauBin; tau++) {
             Complex weight = exp(Complex(0.0, _Map.IndexToTau(tau)));
             uint Index = _Map.GetIndex(UP, UP, Local, Local, 0, tau);
-            _SmoothTWeight[Index] = weight;
+            Narrow(weight, _SmoothTWeight[Index]);
         }
     }
 }
@@ -45,24 +201,128 @@ void GClass::Reset(real Beta)
 
 bool GClass::FromDict(const Dictionary& dict)
 {
-    return _SmoothTWeight.FromDict(dict);
+    return _SmoothTWeight.FromDict(Stored(_Map, dict, SMOOTH, 0, false));
 }
 
 Dictionary GClass::ToDict()
 {
-    return _SmoothTWeight.ToDict();
+    return Saved(_Map, _SmoothTWeight.ToDict(), SMOOTH, 0, false);
+}
+
+real GClass::MaxAbsWeight() const
+{
+    return max(MaxAbs(_SmoothTWeight), MaxAbs(_MeasureWeight));
 }
 
-WClass::WClass(const Lattice& lat, real Beta, uint MaxTauBin)
+void GClass::RoundToFloat()
+{
+    _SmoothTWeight.RoundToFloat();
+    _MeasureWeight.RoundToFloat();
+}
+
+void GClass::TauProfile(spin Spin, int SubIn, int SubOut, real* profile) const
+{
+    uint NTau = _Map.MaxTauBin;
+    for (uint t = 0; t < NTau; t++)
+        profile[t] = 0.0;
+    Site in(SubIn, Vec<int>(0));
+    for (int r = 0; r < _Map.Lat.Vol; r++) {
+        uint Base = BaseIndex(in, Site(SubOut, _Map.Lat.Index2Vec(r)), Spin, Spin);
+        for (uint t = 0; t < NTau; t++)
+            profile[t] += mod(_SmoothTWeight(Base + t));
+    }
+}
+
+WClass::WClass(const Lattice& lat, real Beta, uint MaxTauBin, real Cutoff, real Threshold)
     : _Map(IndexMapSPIN4(Beta, MaxTauBin, lat, TauSymmetric))
+    , _Cutoff(Cutoff)
+    , _Threshold(Threshold)
 {
-    _SmoothTWeight.Allocate(_Map.GetShape(), SMOOTH);
+    _Allocate();
+}
+
+void WClass::_Allocate()
+{
+    _SmoothTWeight.Allocate(_Map.GetShape(), SMOOTH, _Map.ZeroPadding());
     _SmoothTWeight.Assign(Complex(0.0, 0.0));
-    _DeltaTWeight.Allocate(_Map.GetShape(), DELTA);
+    _DeltaTWeight.Allocate(_Map.GetShape(), DELTA, _Map.ZeroPadding());
     _DeltaTWeight.Assign(Complex(0.0, 0.0));
-    _MeasureWeight.Allocate(_Map.GetShape(), SMOOTH);
-    //initialize _MeasureWeight to an unit function
+    _MeasureWeight.Allocate(_Map.GetShape(), SMOOTH, _Map.ZeroPadding());
+    //initialize _MeasureWeight to an unit function, also out of the range, so that Polar is measured everywhere
     _MeasureWeight.Assign(Complex(1.0, 0.0));
+    if (_Map.HasRange())
+        for (uint i = 0; i < _Map.MaxTauBin; i++)
+            Narrow(Complex(1.0, 0.0), _MeasureWeight[_MeasureWeight.GetSize() + _Map.OutOfRangeOffset() + i]);
+}
+
+//shortest periodic image of the displacement Coordi, in unit cells
+real Distance(const Lattice& lat, int Coordi)
+{
+    Vec<int> r = lat.Index2Vec(Coordi);
+    real dist2 = 0.0;
+    for (int d = 0; d < lat.Dimension; d++) {
+        int x = min(r[d], lat.Size[d] - r[d]);
+        dist2 += x * x;
+    }
+    return sqrt(dist2);
+}
+
+/**
+*  A space point is in the range if one of its displacements is within _Cutoff or its max|W| over spins and tau
+*  is above _Threshold times the largest one. The range is symmetric: a point is in it with its reverse
+*  (SubOut, SubIn, -displacement), so that it does not depend on the direction of a line.
+*  The arrays of dict have the layout of dyson/weight.py.
+*/
+void WClass::_SetRange(const Dictionary& dict)
+{
+    const Lattice& lat = _Map.Lat;
+    int NPoint = _Map.NSpacePoint();
+    vector<real> MaxAbsW(NPoint, 0.0);
+    for (auto& Name : { SMOOTH, DELTA }) {
+        auto array = dict.Get<Python::ArrayObject>(Name);
+        const Complex* data = array.Data<Complex>();
+        uint Inner = array.Size() / (IndexMapSPIN4::FullSpin * IndexMapSPIN4::FullSpin * lat.SublatVol * lat.SublatVol * lat.Vol);
+        uint full = 0;
+        for (int sp1 = 0; sp1 < IndexMapSPIN4::FullSpin; sp1++)
+            for (int sub1 = 0; sub1 < lat.SublatVol; sub1++)
+                for (int sp2 = 0; sp2 < IndexMapSPIN4::FullSpin; sp2++)
+                    for (int sub2 = 0; sub2 < lat.SublatVol; sub2++)
+                        for (int coord = 0; coord < lat.Vol; coord++, full++) {
+                            real& m = MaxAbsW[_Map.SpacePoint(sub1, sub2, coord)];
+                            for (uint i = 0; i < Inner; i++)
+                                m = max(m, mod(data[full * Inner + i]));
+                        }
+    }
+    real Largest = *max_element(MaxAbsW.begin(), MaxAbsW.end());
+
+    vector<bool> Close(NPoint, false), InRange(NPoint, false);
+    for (int in = 0; in < lat.SublatVol; in++)
+        for (int out = 0; out < lat.SublatVol; out++)
+            for (int coord = 0; coord < lat.Vol; coord++) {
+                int point = _Map.SpacePoint(in, out, coord);
+                Close[point] = Close[point] || (_Cutoff >= 0.0 && Distance(lat, coord) <= _Cutoff)
+                               || (_Threshold >= 0.0 && MaxAbsW[point] > _Threshold * Largest);
+            }
+    real Dropped = 0.0;
+    int NInRange = 0;
+    for (int in = 0; in < lat.SublatVol; in++)
+        for (int out = 0; out < lat.SublatVol; out++)
+            for (int coord = 0; coord < lat.Vol; coord++) {
+                Vec<int> r = lat.Index2Vec(coord);
+                for (int d = 0; d < lat.Dimension; d++)
+                    r[d] = (lat.Size[d] - r[d]) % lat.Size[d];
+                int point = _Map.SpacePoint(in, out, coord);
+                int reverse = _Map.SpacePoint(out, in, lat.Vec2Index(r));
+                InRange[point] = Close[point] || Close[reverse];
+            }
+    for (int point = 0; point < NPoint; point++)
+        if (InRange[point])
+            NInRange++;
+        else
+            Dropped = max(Dropped, MaxAbsW[point]);
+    _Map.SetRange(InRange);
+    LOG_INFO("W is kept at " << NInRange << " of " << NPoint << " space points, the largest dropped |W| is "
+                             << (Largest > 0.0 ? Dropped / Largest : 0.0) << " of the largest one");
 }
 
 void WClass::BuildTest()
@@ -70,33 +330,78 @@ void WClass::BuildTest()
     _DeltaTWeight.Assign(0.0);
     _SmoothTWeight.Assign(0.0);
     spin UPUP[2] = { UP, UP };
-    for (uint sub = 0; sub < _Map.Lat.SublatVol; sub++) {
+    for (int sub = 0; sub < _Map.Lat.SublatVol; sub++) {
         Site Local(sub, { 0, 0 });
         for (uint tau = 0; tau < _Map.MaxTauBin; tau++) {
             Complex weight = exp(Complex(0.0, -_Map.IndexToTau(tau)));
             uint Index = _Map.GetIndex(UPUP, UPUP, Local, Local, 0, tau);
-            _SmoothTWeight[Index] = weight;
+            Narrow(weight, _SmoothTWeight[Index]);
         }
     }
 }
 
 void WClass::Reset(real Beta)
 {
+    //the range depends on W only, the arrays keep their layout
+    auto InRange = _Map.GetRange();
     _Map = IndexMapSPIN4(Beta, _Map.MaxTauBin, _Map.Lat, _Map.Symmetry);
+    if (!InRange.empty())
+        _Map.SetRange(InRange);
 }
 
 bool WClass::FromDict(const Dictionary& dict)
 {
-    return _SmoothTWeight.FromDict(dict) && _DeltaTWeight.FromDict(dict);
+    auto full = dict;
+    if (_Cutoff >= 0.0 || _Threshold >= 0.0) {
+        //the range is found again from the full arrays
+        _Map = IndexMapSPIN4(_Map.Beta, _Map.MaxTauBin, _Map.Lat, _Map.Symmetry);
+        full = Full(_Map, Full(_Map, dict, SMOOTH, 0, false), DELTA, 0, false);
+        _SetRange(full);
+        _Allocate();
+    }
+    auto stored = Stored(_Map, Stored(_Map, full, SMOOTH, 0, false), DELTA, 0, false);
+    return _SmoothTWeight.FromDict(stored) && _DeltaTWeight.FromDict(stored);
 }
 
 Dictionary WClass::ToDict()
 {
-    auto dict = _SmoothTWeight.ToDict();
-    dict.Update(_DeltaTWeight.ToDict());
+    auto dict = Saved(_Map, _SmoothTWeight.ToDict(), SMOOTH, 0, false);
+    dict.Update(Saved(_Map, _DeltaTWeight.ToDict(), DELTA, 0, false));
     return dict;
 }
 
+real WClass::MaxAbsWeight() const
+{
+    return max(max(MaxAbs(_SmoothTWeight), MaxAbs(_DeltaTWeight)), MaxAbs(_MeasureWeight));
+}
+
+void WClass::RoundToFloat()
+{
+    _SmoothTWeight.RoundToFloat();
+    _DeltaTWeight.RoundToFloat();
+    _MeasureWeight.RoundToFloat();
+}
+
+void WClass::SpaceProfile(int SubIn, int SubOut, real* profile) const
+{
+    uint NTau = _Map.MaxTauBin;
+    Site in(SubIn, Vec<int>(0));
+    for (int r = 0; r < _Map.Lat.Vol; r++) {
+        Site out(SubOut, _Map.Lat.Index2Vec(r));
+        profile[r] = 0.0;
+        //unconserved spins of SPIN_CONSERVED builds land in the zero padding
+        for (int sp1 = 0; sp1 < IndexMapSPIN4::FullSpin; sp1++)
+            for (int sp2 = 0; sp2 < IndexMapSPIN4::FullSpin; sp2++) {
+                spin SpinIn[2] = { spin(sp1 / SPIN), spin(sp1 % SPIN) };
+                spin SpinOut[2] = { spin(sp2 / SPIN), spin(sp2 % SPIN) };
+                profile[r] += mod(_DeltaTWeight(_Map.GetIndex(SpinIn, SpinOut, in, out)));
+                uint Base = BaseIndex(in, out, SpinIn, SpinOut);
+                for (uint t = 0; t < NTau; t++)
+                    profile[r] += mod(_SmoothTWeight(Base + t));
+            }
+    }
+}
+
 SigmaClass::SigmaClass(const Lattice& lat, real Beta, uint MaxTauBin,
              int MaxOrder, TauSymmetry Symmetry, real Norm)
     : _Map(IndexMapSPIN2(Beta, MaxTauBin, lat, Symmetry))
@@ -122,13 +427,14 @@ void SigmaClass::Reset(real Beta)
 
 bool SigmaClass::FromDict(const Dictionary& dict)
 {
-    return Estimator.FromDict(dict.Get<Dictionary>("Histogram").Get<Dictionary>("SmoothT"));
+    //the estimator has the order axis in front
+    return Estimator.FromDict(Stored(_Map, dict.Get<Dictionary>("Histogram").Get<Dictionary>("SmoothT"), "WeightAccu", 1, true));
 }
 
 Dictionary SigmaClass::ToDict()
 {
     Dictionary dict;
-    dict["Histogram"] = Dictionary("SmoothT", Estimator.ToDict());
+    dict["Histogram"] = Dictionary("SmoothT", Saved(_Map, Estimator.ToDict(), "WeightAccu", 1, true));
     return dict;
 }
 
@@ -156,12 +462,13 @@ void PolarClass::Reset(real Beta)
 
 bool PolarClass::FromDict(const Dictionary& dict)
 {
-    return Estimator.FromDict(dict.Get<Dictionary>("Histogram").Get<Dictionary>("SmoothT"));
+    //the estimator has the order axis in front
+    return Estimator.FromDict(Stored(_Map, dict.Get<Dictionary>("Histogram").Get<Dictionary>("SmoothT"), "WeightAccu", 1, true));
 }
 
 Dictionary PolarClass::ToDict()
 {
     Dictionary dict;
-    dict["Histogram"] = Dictionary("SmoothT", Estimator.ToDict());
+    dict["Histogram"] = Dictionary("SmoothT", Saved(_Map, Estimator.ToDict(), "WeightAccu", 1, true));
     return dict;
 }
@@ -33,8 +33,10 @@ class Norm {
     }
 };
 
-typedef WeightArray<DELTA_T_SIZE> DeltaTArray;
-typedef WeightArray<SMOOTH_T_SIZE> SmoothTArray;
+typedef WeightArray<DELTA_T_SIZE, WeightStorage> DeltaTArray;
+typedef WeightArray<SMOOTH_T_SIZE, WeightStorage> SmoothTArray;
+//spins of both ends of a worm W line
+const spin SPINUPUP[2] = { UP, UP };
 
 class GClass{
   public:
@@ -45,8 +47,28 @@ class GClass{
     bool FromDict(const Dictionary &);
     Dictionary ToDict();
 
-    Complex Weight(const Site &, const Site &, real, real, spin, spin, bool) const;
-    Complex Weight(int, const Site &, const Site &, real, real, spin, spin, bool) const;
+    //the flag is a template parameter, so that call sites which know it skip the branches
+    template <bool IsMeasure>
+    Amplitude Weight(const Site &, const Site &, real, real, spin, spin) const;
+    template <bool IsMeasure>
+    Amplitude Weight(int, const Site &, const Site &, real, real, spin, spin) const;
+    //dispatch to the templates above with a runtime flag
+    Amplitude Weight(const Site &, const Site &, real, real, spin, spin, bool) const;
+    Amplitude Weight(int, const Site &, const Site &, real, real, spin, spin, bool) const;
+    //weights of n lines between the same sites and spins, with times tin[i], tout[i]
+    void Weight(const Site &, const Site &, const real *tin, const real *tout, spin, spin, bool,
+                int n, Amplitude *weight) const;
+    //index of a line at tin=tout=0, only the tau bin has to be added for other times
+    uint BaseIndex(const Site &, const Site &, spin, spin) const;
+    //weights of n unrelated lines with indexes Base[i] and times tin[i], tout[i], as real and imaginary parts
+    void Weight(int n, const uint *Base, const real *tin, const real *tout, const bool *IsMeasure,
+                real *re, real *im) const;
+    //upper bound of |Weight(...)| for any arguments
+    real MaxAbsWeight() const;
+    //|G| summed over coordinates in each of the MaxTauBin tau bins, for lines of one spin from SubIn to SubOut
+    void TauProfile(spin, int SubIn, int SubOut, real *profile) const;
+    //round the tables to the precision of a SINGLE_PRECISION_WEIGHT build
+    void RoundToFloat();
 
   private:
     SmoothTArray _SmoothTWeight;
@@ -60,21 +82,54 @@ class GClass{
 */
 class WClass {
   public:
-    WClass(const Lattice &lat, real Beta, uint MaxTauBin);
+    /**
+    *  with Cutoff or Threshold not negative, FromDict keeps only the displacements within Cutoff unit cells
+    *  or with max|W| above Threshold times the largest one; W is zero at the others
+    */
+    WClass(const Lattice &lat, real Beta, uint MaxTauBin, real Cutoff = -1.0, real Threshold = -1.0);
     void BuildTest();
     void WriteBareToASCII();
     void Reset(real Beta);
     bool FromDict(const Dictionary &);
     Dictionary ToDict();
 
-    Complex Weight(const Site &, const Site &, real, real, spin *, spin *, bool, bool, bool) const;
-    Complex Weight(int, const Site &, const Site &, real, real, spin *, spin *, bool, bool, bool) const;
+    //flags are template parameters, so that call sites which know them skip the branches; a measuring line is never delta
+    template <bool IsWorm, bool IsMeasure, bool IsDelta>
+    Amplitude Weight(const Site &, const Site &, real, real, spin *, spin *) const;
+    template <bool IsWorm, bool IsMeasure, bool IsDelta>
+    Amplitude Weight(int, const Site &, const Site &, real, real, spin *, spin *) const;
+    //dispatch to the templates above with runtime flags IsWorm, IsMeasure, IsDelta
+    Amplitude Weight(const Site &, const Site &, real, real, spin *, spin *, bool, bool, bool) const;
+    Amplitude Weight(int, const Site &, const Site &, real, real, spin *, spin *, bool, bool, bool) const;
+    //weights of n lines between the same sites and spins, with times t1[i], t2[i]
+    void Weight(int, const Site &, const Site &, const real *t1, const real *t2, spin *, spin *, bool, bool, bool,
+                int n, Amplitude *weight) const;
+    //index of a smooth line at tin=tout=0, only the tau bin has to be added for other times
+    uint BaseIndex(const Site &, const Site &, spin *, spin *) const;
+    //weights of n unrelated smooth lines with indexes Base[i] and times tin[i], tout[i], as real and imaginary parts
+    void Weight(int n, const uint *Base, const real *tin, const real *tout, const bool *IsMeasure,
+                real *re, real *im) const;
+    //upper bound of |Weight(...)| for any arguments
+    real MaxAbsWeight() const;
+    //|W| summed over spins and tau at each of the Vol coordinates, for lines from SubIn to SubOut
+    void SpaceProfile(int SubIn, int SubOut, real *profile) const;
+    //false if W is zero between the sites for any spins and times; the measuring line is never out of the range
+    bool IsInRange(const Site &r1, const Site &r2) const
+    {
+        return _Map.IsInRange(r1, r2);
+    }
+    //round the tables to the precision of a SINGLE_PRECISION_WEIGHT build
+    void RoundToFloat();
 
   protected:
     DeltaTArray _DeltaTWeight;
     SmoothTArray _SmoothTWeight;
     weight::SmoothTArray _MeasureWeight;
     IndexMapSPIN4 _Map;
+    real _Cutoff;
+    real _Threshold;
+    void _Allocate();
+    void _SetRange(const Dictionary &);
 };
 
 class SigmaClass {
@@ -89,7 +144,10 @@ class SigmaClass {
     Dictionary ToDict();
 
     void Measure(const Site &, const Site &, real, real, spin, spin,
-                 int Order, const Complex &);
+                 int Order, const Amplitude &);
+    //index into Estimator of a measurement; Measure multiplies its weight by TauSymmetryFactor
+    uint MeasureIndex(const Site &, const Site &, real, real, spin, spin) const;
+    int TauSymmetryFactor(real, real) const;
     WeightEstimator Estimator;
 
   protected:
@@ -107,13 +165,56 @@ class PolarClass {
     Dictionary ToDict();
 
     void Measure(const Site &, const Site &, real, real, spin *, spin *,
-                 int Order, const Complex &);
+                 int Order, const Amplitude &);
+    uint MeasureIndex(const Site &, const Site &, real, real, spin *, spin *) const;
     WeightEstimator Estimator;
 
   protected:
     IndexMapSPIN4 _Map;
 };
 
+template <bool IsMeasure>
+Amplitude GClass::Weight(const Site &rin, const Site &rout, real tin, real tout, spin SpinIn, spin SpinOut) const
+{
+    uint Index = _Map.GetIndex(SpinIn, SpinOut, rin, rout, tin, tout);
+    if (IsMeasure)
+        return _MeasureWeight(Index);
+    return _Map.GetTauSymmetryFactor(tin, tout) * _SmoothTWeight(Index);
+}
+
+template <bool IsMeasure>
+Amplitude GClass::Weight(int dir, const Site &r1, const Site &r2, real t1, real t2, spin Spin1, spin Spin2) const
+{
+    if (dir == IN)
+        return Weight<IsMeasure>(r1, r2, t1, t2, Spin1, Spin2);
+    return Weight<IsMeasure>(r2, r1, t2, t1, Spin2, Spin1);
+}
+
+template <bool IsWorm, bool IsMeasure, bool IsDelta>
+Amplitude WClass::Weight(const Site &rin, const Site &rout, real tin, real tout, spin *SpinIn, spin *SpinOut) const
+{
+    static_assert(!(IsMeasure && IsDelta), "the measuring W line can not be a delta line!");
+    if (IsWorm) {
+        //it is safe to reassign pointer here, the original spins pointed by SpinIn and SpinOut pointers will not change
+        SpinIn = (spin *)SPINUPUP;
+        SpinOut = (spin *)SPINUPUP;
+    }
+    if (IsDelta)
+        return _DeltaTWeight(_Map.GetIndex(SpinIn, SpinOut, rin, rout));
+    uint Index = _Map.GetIndex(SpinIn, SpinOut, rin, rout, tin, tout);
+    if (IsMeasure)
+        return _MeasureWeight(Index);
+    return _SmoothTWeight(Index);
+}
+
+template <bool IsWorm, bool IsMeasure, bool IsDelta>
+Amplitude WClass::Weight(int dir, const Site &r1, const Site &r2, real t1, real t2, spin *Spin1, spin *Spin2) const
+{
+    if (dir == IN)
+        return Weight<IsWorm, IsMeasure, IsDelta>(r1, r2, t1, t2, Spin1, Spin2);
+    return Weight<IsWorm, IsMeasure, IsDelta>(r2, r1, t2, t1, Spin2, Spin1);
+}
+
 int TestWeight();
 }
 
@@ -11,91 +11,165 @@
 using namespace weight;
 using namespace std;
 
-const spin SPINUPUP[2] = { UP, UP };
+//lines whose tau bins are computed in one go by the lane lookups
+const int LANE_CHUNK = 16;
 
-Complex GClass::Weight(const Site& rin, const Site& rout, real tin, real tout, spin SpinIn, spin SpinOut, bool IsMeasure) const
+Amplitude GClass::Weight(const Site& rin, const Site& rout, real tin, real tout, spin SpinIn, spin SpinOut, bool IsMeasure) const
 {
-    uint Index = _Map.GetIndex(SpinIn, SpinOut, rin, rout, tin, tout);
     if (IsMeasure)
-        return _MeasureWeight(Index);
-    else
-        return _Map.GetTauSymmetryFactor(tin, tout) * _SmoothTWeight(Index);
+        return Weight<true>(rin, rout, tin, tout, SpinIn, SpinOut);
+    return Weight<false>(rin, rout, tin, tout, SpinIn, SpinOut);
 }
 
-Complex GClass::Weight(int dir, const Site& r1, const Site& r2, real t1, real t2, spin Spin1, spin Spin2, bool IsMeasure) const
+Amplitude GClass::Weight(int dir, const Site& r1, const Site& r2, real t1, real t2, spin Spin1, spin Spin2, bool IsMeasure) const
 {
-    static uint Index;
-    int symmetryfactor;
-    if (dir == IN) {
-        Index = _Map.GetIndex(Spin1, Spin2, r1, r2, t1, t2);
-        symmetryfactor = _Map.GetTauSymmetryFactor(t1, t2);
+    if (IsMeasure)
+        return Weight<true>(dir, r1, r2, t1, t2, Spin1, Spin2);
+    return Weight<false>(dir, r1, r2, t1, t2, Spin1, Spin2);
+}
+
+void GClass::Weight(const Site& rin, const Site& rout, const real* tin, const real* tout, spin SpinIn, spin SpinOut, bool IsMeasure,
+                    int n, Amplitude* weight) const
+{
+    //only the tau bin differs between the lines
+    uint Base = _Map.GetIndex(SpinIn, SpinOut, rin, rout, 0.0, 0.0);
+    if (IsMeasure) {
+        for (int i = 0; i < n; i++)
+            weight[i] = _MeasureWeight(Base + _Map.TauIndex(tin[i], tout[i]));
+        return;
     }
-    else {
-        Index = _Map.GetIndex(Spin2, Spin1, r2, r1, t2, t1);
-        symmetryfactor = _Map.GetTauSymmetryFactor(t2, t1);
+    for (int i = 0; i < n; i++)
+        weight[i] = _Map.GetTauSymmetryFactor(tin[i], tout[i]) * _SmoothTWeight(Base + _Map.TauIndex(tin[i], tout[i]));
+}
+
+uint GClass::BaseIndex(const Site& rin, const Site& rout, spin SpinIn, spin SpinOut) const
+{
+    return _Map.GetIndex(SpinIn, SpinOut, rin, rout, 0.0, 0.0);
+}
+
+void GClass::Weight(int n, const uint* Base, const real* tin, const real* tout, const bool* IsMeasure,
+                    real* re, real* im) const
+{
+    const WeightStorage* smooth = _SmoothTWeight.Data();
+    const WeightStorage* measure = _MeasureWeight.Data();
+    int bin[LANE_CHUNK];
+    for (int start = 0; start < n; start += LANE_CHUNK) {
+        int m = min(LANE_CHUNK, n - start);
+        _Map.TauIndex(m, tin + start, tout + start, bin);
+        for (int j = 0, i = start; j < m; j++, i++) {
+            const WeightStorage& w = (IsMeasure[i] ? measure : smooth)[Base[i] + bin[j]];
+            real factor = (IsMeasure[i] || tout[i] > tin[i]) ? 1.0 : real(_Map.Symmetry);
+            re[i] = factor * RealPart(w);
+            im[i] = factor * ImagPart(w);
+        }
     }
+}
 
+//a delta line wins over a measuring line, which should never happen together
+Amplitude WClass::Weight(const Site& rin, const Site& rout, real tin, real tout, spin* SpinIn, spin* SpinOut, bool IsWorm, bool IsMeasure, bool IsDelta) const
+{
+    if (IsWorm) {
+        if (IsDelta)
+            return Weight<true, false, true>(rin, rout, tin, tout, SpinIn, SpinOut);
+        if (IsMeasure)
+            return Weight<true, true, false>(rin, rout, tin, tout, SpinIn, SpinOut);
+        return Weight<true, false, false>(rin, rout, tin, tout, SpinIn, SpinOut);
+    }
+    if (IsDelta)
+        return Weight<false, false, true>(rin, rout, tin, tout, SpinIn, SpinOut);
     if (IsMeasure)
-        return _MeasureWeight(Index);
-    else
-        return symmetryfactor * _SmoothTWeight(Index);
+        return Weight<false, true, false>(rin, rout, tin, tout, SpinIn, SpinOut);
+    return Weight<false, false, false>(rin, rout, tin, tout, SpinIn, SpinOut);
 }
 
-Complex WClass::Weight(const Site& rin, const Site& rout, real tin, real tout, spin* SpinIn, spin* SpinOut, bool IsWorm, bool IsMeasure, bool IsDelta) const
+Amplitude WClass::Weight(int dir, const Site& r1, const Site& r2, real t1, real t2, spin* Spin1, spin* Spin2, bool IsWorm, bool IsMeasure, bool IsDelta) const
 {
-    static uint index;
     if (IsWorm) {
-        //it is safe to reassign pointer here, the original spins pointed by SpinIn and SpinOut pointers will not change
-        SpinIn = (spin*)SPINUPUP;
-        SpinOut = (spin*)SPINUPUP;
-    }
-    if (IsDelta) {
-        index = _Map.GetIndex(SpinIn, SpinOut, rin, rout);
-        return _DeltaTWeight(index);
+        if (IsDelta)
+            return Weight<true, false, true>(dir, r1, r2, t1, t2, Spin1, Spin2);
+        if (IsMeasure)
+            return Weight<true, true, false>(dir, r1, r2, t1, t2, Spin1, Spin2);
+        return Weight<true, false, false>(dir, r1, r2, t1, t2, Spin1, Spin2);
     }
-    index = _Map.GetIndex(SpinIn, SpinOut, rin, rout, tin, tout);
+    if (IsDelta)
+        return Weight<false, false, true>(dir, r1, r2, t1, t2, Spin1, Spin2);
     if (IsMeasure)
-        return _MeasureWeight(index);
-    else
-        return _SmoothTWeight(index);
+        return Weight<false, true, false>(dir, r1, r2, t1, t2, Spin1, Spin2);
+    return Weight<false, false, false>(dir, r1, r2, t1, t2, Spin1, Spin2);
 }
 
-Complex WClass::Weight(int dir, const Site& r1, const Site& r2, real t1, real t2, spin* Spin1, spin* Spin2, bool IsWorm, bool IsMeasure, bool IsDelta) const
+void WClass::Weight(int dir, const Site& r1, const Site& r2, const real* t1, const real* t2, spin* Spin1, spin* Spin2,
+                    bool IsWorm, bool IsMeasure, bool IsDelta, int n, Amplitude* weight) const
 {
-    static uint index;
+    if (IsDelta) {
+        for (int i = 0; i < n; i++)
+            weight[i] = Weight(dir, r1, r2, t1[i], t2[i], Spin1, Spin2, IsWorm, IsMeasure, IsDelta);
+        return;
+    }
     if (IsWorm) {
         Spin1 = (spin*)SPINUPUP;
         Spin2 = (spin*)SPINUPUP;
     }
-    if (dir == IN)
-        if (IsDelta)
-            index = _Map.GetIndex(Spin1, Spin2, r1, r2);
-        else
-            index = _Map.GetIndex(Spin1, Spin2, r1, r2, t1, t2);
+    //only the tau bin differs between the lines
+    const SmoothTArray& Array = IsMeasure ? _MeasureWeight : _SmoothTWeight;
+    if (dir == IN) {
+        uint Base = _Map.GetIndex(Spin1, Spin2, r1, r2, 0.0, 0.0);
+        for (int i = 0; i < n; i++)
+            weight[i] = Array(Base + _Map.TauIndex(t1[i], t2[i]));
+    }
+    else {
+        uint Base = _Map.GetIndex(Spin2, Spin1, r2, r1, 0.0, 0.0);
+        for (int i = 0; i < n; i++)
+            weight[i] = Array(Base + _Map.TauIndex(t2[i], t1[i]));
+    }
+}
 
-    else if (IsDelta)
-        index = _Map.GetIndex(Spin2, Spin1, r2, r1);
-    else
-        index = _Map.GetIndex(Spin2, Spin1, r2, r1, t2, t1);
+uint WClass::BaseIndex(const Site& rin, const Site& rout, spin* SpinIn, spin* SpinOut) const
+{
+    return _Map.GetIndex(SpinIn, SpinOut, rin, rout, 0.0, 0.0);
+}
 
-    if (IsMeasure)
-        return _MeasureWeight(index);
-    else if (IsDelta)
-        return _DeltaTWeight(index);
-    else
-        return _SmoothTWeight(index);
+void WClass::Weight(int n, const uint* Base, const real* tin, const real* tout, const bool* IsMeasure,
+                    real* re, real* im) const
+{
+    const WeightStorage* smooth = _SmoothTWeight.Data();
+    const WeightStorage* measure = _MeasureWeight.Data();
+    int bin[LANE_CHUNK];
+    for (int start = 0; start < n; start += LANE_CHUNK) {
+        int m = min(LANE_CHUNK, n - start);
+        _Map.TauIndex(m, tin + start, tout + start, bin);
+        for (int j = 0, i = start; j < m; j++, i++) {
+            const WeightStorage& w = (IsMeasure[i] ? measure : smooth)[Base[i] + bin[j]];
+            re[i] = RealPart(w);
+            im[i] = ImagPart(w);
+        }
+    }
+}
+
+void SigmaClass::Measure(const Site& rin, const Site& rout, real tin, real tout, spin SpinIn, spin SpinOut, int order, const Amplitude& weight)
+{
+    Estimator.Measure(MeasureIndex(rin, rout, tin, tout, SpinIn, SpinOut), order, weight * TauSymmetryFactor(tin, tout));
+}
+
+void PolarClass::Measure(const Site& rin, const Site& rout, real tin, real tout, spin* SpinIn, spin* SpinOut, int order, const Amplitude& weight)
+{
+    Estimator.Measure(MeasureIndex(rin, rout, tin, tout, SpinIn, SpinOut), order, weight);
+}
+
+uint SigmaClass::MeasureIndex(const Site& rin, const Site& rout, real tin, real tout, spin SpinIn, spin SpinOut) const
+{
+    return _Map.GetIndex(SpinIn, SpinOut, rin, rout, tin, tout);
 }
 
-void SigmaClass::Measure(const Site& rin, const Site& rout, real tin, real tout, spin SpinIn, spin SpinOut, int order, const Complex& weight)
+int SigmaClass::TauSymmetryFactor(real tin, real tout) const
 {
-    static uint index;
-    index = _Map.GetIndex(SpinIn, SpinOut, rin, rout, tin, tout);
-    Estimator.Measure(index, order, weight * _Map.GetTauSymmetryFactor(tin, tout));
+    return _Map.GetTauSymmetryFactor(tin, tout);
 }
 
-void PolarClass::Measure(const Site& rin, const Site& rout, real tin, real tout, spin* SpinIn, spin* SpinOut, int order, const Complex& weight)
+uint PolarClass::MeasureIndex(const Site& rin, const Site& rout, real tin, real tout, spin* SpinIn, spin* SpinOut) const
 {
-    static uint index;
-    index = _Map.GetIndex(SpinIn, SpinOut, rin, rout, tin, tout);
-    Estimator.Measure(index, order, weight);
+    //the measuring W line has zero weight with unconserved spins in SPIN_CONSERVED builds
+    if (DEBUGMODE && _Map.IsCompact() && _Map.Channel(SpinIn, SpinOut) < 0)
+        ABORT("Polar is measured with spins not conserved along the W line!");
+    return _Map.GetIndex(SpinIn, SpinOut, rin, rout, tin, tout);
 }
@@ -22,9 +22,16 @@ IndexMap::IndexMap(real Beta_, uint MaxTauBin_, const Lattice& lat, TauSymmetry
     Lat = lat;
     Symmetry = Symmetry_;
     _TauSymmetryFactor = int(Symmetry);
-    _Shape[SUB1] = (uint)Lat.SublatVol;
-    _Shape[SUB2] = (uint)Lat.SublatVol;
-    _Shape[VOL] = (uint)Lat.Vol;
+    if (Lat.HasPointGroup()) {
+        _Shape[SUB1] = 1;
+        _Shape[SUB2] = 1;
+        _Shape[VOL] = (uint)Lat.NClass;
+    }
+    else {
+        _Shape[SUB1] = (uint)Lat.SublatVol;
+        _Shape[SUB2] = (uint)Lat.SublatVol;
+        _Shape[VOL] = (uint)Lat.Vol;
+    }
     _Shape[TAU] = MaxTauBin;
 }
 
@@ -56,6 +63,14 @@ int IndexMap::TauIndex(real t_in, real t_out) const
     return TauIndex(t_out - t_in);
 }
 
+void IndexMap::TauIndex(int n, const real* t_in, const real* t_out, int* bin) const
+{
+    for (int i = 0; i < n; i++) {
+        real tau = t_out[i] - t_in[i];
+        bin[i] = int(floor(tau * _dBetaInverse)) + (tau < 0.0) * int(MaxTauBin);
+    }
+}
+
 real IndexMap::IndexToTau(int Bin) const
 {
     //TODO: mapping between tau and bin
@@ -67,15 +82,45 @@ const uint* IndexMap::GetShape() const
     return _Shape;
 }
 
+int IndexMap::NSpacePoint() const
+{
+    if (Lat.HasPointGroup())
+        return Lat.NClass;
+    return Lat.SublatVol * Lat.SublatVol * Lat.Vol;
+}
+
+void IndexMap::SetRange(const std::vector<bool>& InRange)
+{
+    ASSERT_ALLWAYS(int(InRange.size()) == NSpacePoint(), "The range should have " << NSpacePoint() << " space points!");
+    _Slot.assign(InRange.size(), -1);
+    int NSlot = 0;
+    for (uint point = 0; point < InRange.size(); point++)
+        if (InRange[point])
+            _Slot[point] = NSlot++;
+    ASSERT_ALLWAYS(NSlot > 0, "No space point is in the range!");
+    _Shape[SUB1] = 1;
+    _Shape[SUB2] = 1;
+    _Shape[VOL] = (uint)NSlot;
+    _UpdateCache();
+}
+
+std::vector<bool> IndexMap::GetRange() const
+{
+    std::vector<bool> InRange(_Slot.size());
+    for (uint point = 0; point < _Slot.size(); point++)
+        InRange[point] = (_Slot[point] >= 0);
+    return InRange;
+}
+
 void IndexMap::_UpdateCache()
 {
     _SizeDeltaT = 1;
-    for (auto i = 0; i < DELTA_T_SIZE; i++) {
+    for (uint i = 0; i < DELTA_T_SIZE; i++) {
         _CacheDeltaT[DELTA_T_SIZE - 1 - i] = _SizeDeltaT;
         _SizeDeltaT *= _Shape[DELTA_T_SIZE - 1 - i];
     }
     _SizeSmoothT = 1;
-    for (auto i = 0; i < SMOOTH_T_SIZE; i++) {
+    for (uint i = 0; i < SMOOTH_T_SIZE; i++) {
         _CacheSmoothT[SMOOTH_T_SIZE - 1 - i] = _SizeSmoothT;
         _SizeSmoothT *= _Shape[SMOOTH_T_SIZE - 1 - i];
     }
@@ -103,9 +148,8 @@ uint IndexMapSPIN2::GetIndex(spin in, spin out, const Site& rin, const Site& rou
                              real tin, real tout) const
 {
     auto coord = Lat.CoordiIndex(rin, rout);
-    uint Index = in * _CacheSmoothT[SP1] + rin.Sublattice * _CacheSmoothT[SUB1]
-                 + out * _CacheSmoothT[SP2] + rout.Sublattice * _CacheSmoothT[SUB2]
-                 + coord * _CacheSmoothT[VOL] + TauIndex(tin, tout);
+    uint Index = in * _CacheSmoothT[SP1] + out * _CacheSmoothT[SP2]
+                 + _SpaceIndex(rin.Sublattice, rout.Sublattice, coord, _CacheSmoothT) + TauIndex(tin, tout);
     if (DEBUGMODE && Index >= _SizeSmoothT)
         THROW_ERROR(IndexInvalid, "exceed array bound!");
     return Index;
@@ -115,22 +159,92 @@ uint IndexMapSPIN2::GetIndex(spin in, spin out,
                              const Site& rin, const Site& rout) const
 {
     auto coord = Lat.CoordiIndex(rin, rout);
-    uint Index = in * _CacheDeltaT[SP1] + rin.Sublattice * _CacheDeltaT[SUB1]
-                 + out * _CacheDeltaT[SP2] + rout.Sublattice * _CacheDeltaT[SUB2]
-                 + coord;
+    uint Index = in * _CacheDeltaT[SP1] + out * _CacheDeltaT[SP2]
+                 + _SpaceIndex(rin.Sublattice, rout.Sublattice, coord, _CacheDeltaT);
     if (DEBUGMODE && Index >= _SizeDeltaT)
         THROW_ERROR(IndexInvalid, "exceed array bound!");
     return Index;
 }
 
+int IndexMapSPIN2::StoredIndex(int SpinIn, int SubIn, int SpinOut, int SubOut, int Coordi) const
+{
+    return SpinIn * _CacheDeltaT[SP1] + SpinOut * _CacheDeltaT[SP2] + _SpaceIndex(SubIn, SubOut, Coordi, _CacheDeltaT);
+}
+
+//conserved channel of the spin pair indexes of both ends, in the order of GetConservedSpinTuple("FourSpins")
+const int SPIN4_CHANNEL[4][4] = {
+    { 0, -1, -1, 2 },
+    { -1, -1, 4, -1 },
+    { -1, 5, -1, -1 },
+    { 3, -1, -1, 1 }
+};
+
 IndexMapSPIN4::IndexMapSPIN4(real Beta, uint MaxTauBin, const Lattice& Lat, TauSymmetry Symmetry)
     : IndexMap(Beta, MaxTauBin, Lat, Symmetry)
 {
-    _Shape[SP1] = 4;
-    _Shape[SP2] = 4;
+    if (IsCompact()) {
+        _Shape[SP1] = Channels;
+        _Shape[SP2] = 1;
+    }
+    else {
+        _Shape[SP1] = 4;
+        _Shape[SP2] = 4;
+    }
     _UpdateCache();
 }
 
+bool IndexMapSPIN4::IsCompact()
+{
+#ifdef SPIN_CONSERVED
+    return true;
+#else
+    return false;
+#endif
+}
+
+int IndexMapSPIN4::Channel(int SpinIndexIn, int SpinIndexOut)
+{
+    return SPIN4_CHANNEL[SpinIndexIn][SpinIndexOut];
+}
+
+int IndexMapSPIN4::Channel(const spin* SpinIn, const spin* SpinOut)
+{
+    return SPIN4_CHANNEL[SpinIndex(SpinIn)][SpinIndex(SpinOut)];
+}
+
+void IndexMapSPIN4::ChannelToSpinIndex(int channel, int& SpinIndexIn, int& SpinIndexOut)
+{
+    for (SpinIndexIn = 0; SpinIndexIn < 4; SpinIndexIn++)
+        for (SpinIndexOut = 0; SpinIndexOut < 4; SpinIndexOut++)
+            if (SPIN4_CHANNEL[SpinIndexIn][SpinIndexOut] == channel)
+                return;
+    ABORT("Channel " << channel << " does not exist!");
+}
+
+int IndexMapSPIN4::StoredIndex(int SpinIndexIn, int SubIn, int SpinIndexOut, int SubOut, int Coordi) const
+{
+    uint SpinOffset;
+    if (IsCompact()) {
+        int channel = Channel(SpinIndexIn, SpinIndexOut);
+        if (channel < 0)
+            return -1;
+        SpinOffset = channel * _CacheDeltaT[SP1];
+    }
+    else
+        SpinOffset = SpinIndexIn * _CacheDeltaT[SP1] + SpinIndexOut * _CacheDeltaT[SP2];
+    int Space = _SpaceIndex(SubIn, SubOut, Coordi, _CacheDeltaT);
+    if (Space < 0)
+        return OUT_OF_RANGE;
+    return SpinOffset + Space;
+}
+
+uint IndexMapSPIN4::ZeroPadding() const
+{
+    if (HasRange())
+        return OutOfRangeOffset() + MaxTauBin;
+    return IsCompact() ? MaxTauBin : 0;
+}
+
 //First In/Out: direction of WLine; Second In/Out: direction of Vertex
 int IndexMapSPIN4::SpinIndex(spin SpinInIn, spin SpinInOut, spin SpinOutIn, spin SpinOutOut)
 {
@@ -149,9 +263,19 @@ int IndexMapSPIN4::SpinIndex(const spin* Spin)
 
 uint IndexMapSPIN4::GetIndex(const spin* SpinIn, const spin* SpinOut, const Site& rin, const Site& rout, real tin, real tout) const
 {
+#ifdef SPIN_CONSERVED
+    int channel = Channel(SpinIn, SpinOut);
+    if (channel < 0)
+        return _SizeSmoothT + TauIndex(tin, tout);
+    uint SpinOffset = channel * _CacheSmoothT[SP1];
+#else
+    uint SpinOffset = SpinIndex(SpinIn) * _CacheSmoothT[SP1] + SpinIndex(SpinOut) * _CacheSmoothT[SP2];
+#endif
     auto coord = Lat.CoordiIndex(rin, rout);
-    uint Index = SpinIndex(SpinIn) * _CacheSmoothT[SP1] + rin.Sublattice * _CacheSmoothT[SUB1]
-                 + SpinIndex(SpinOut) * _CacheSmoothT[SP2] + rout.Sublattice * _CacheSmoothT[SUB2] + coord * _CacheSmoothT[VOL] + TauIndex(tin, tout);
+    int Space = _SpaceIndex(rin.Sublattice, rout.Sublattice, coord, _CacheSmoothT);
+    if (Space < 0)
+        return _SizeSmoothT + OutOfRangeOffset() + TauIndex(tin, tout);
+    uint Index = SpinOffset + Space + TauIndex(tin, tout);
     if (DEBUGMODE && Index >= _SizeSmoothT)
         THROW_ERROR(IndexInvalid, "exceed array bound!");
     return Index;
@@ -159,11 +283,20 @@ uint IndexMapSPIN4::GetIndex(const spin* SpinIn, const spin* SpinOut, const Site
 
 uint IndexMapSPIN4::GetIndex(const spin* SpinIn, const spin* SpinOut, const Site& rin, const Site& rout) const
 {
+#ifdef SPIN_CONSERVED
+    int channel = Channel(SpinIn, SpinOut);
+    if (channel < 0)
+        return _SizeDeltaT;
+    uint SpinOffset = channel * _CacheDeltaT[SP1];
+#else
+    uint SpinOffset = SpinIndex(SpinIn) * _CacheDeltaT[SP1] + SpinIndex(SpinOut) * _CacheDeltaT[SP2];
+#endif
     auto coord = Lat.CoordiIndex(rin, rout);
-    uint Index = SpinIndex(SpinIn) * _CacheDeltaT[SP1] + rin.Sublattice * _CacheDeltaT[SUB1]
-                 + SpinIndex(SpinOut) * _CacheDeltaT[SP2] + rout.Sublattice * _CacheDeltaT[SUB2]
-                 + coord;
+    int Space = _SpaceIndex(rin.Sublattice, rout.Sublattice, coord, _CacheDeltaT);
+    if (Space < 0)
+        return _SizeDeltaT + OutOfRangeOffset();
+    uint Index = SpinOffset + Space;
     if (DEBUGMODE && Index >= _SizeDeltaT)
         THROW_ERROR(IndexInvalid, "exceed array bound!");
     return Index;
-}
\ No newline at end of file
+}
@@ -30,6 +30,9 @@ enum TauSymmetry {
 const uint DELTA_T_SIZE = 5;
 const uint SMOOTH_T_SIZE = 6;
 
+//StoredIndex of a point whose spins are not conserved is -1, of a point out of the range of the map OUT_OF_RANGE
+const int OUT_OF_RANGE = -2;
+
 enum SPIN4Filter { UpUp2UpUp,
                    UpDown2UpDown,
                    UpDown2DownUp };
@@ -45,10 +48,46 @@ public:
     TauSymmetry Symmetry;
     int TauIndex(real tau) const;
     int TauIndex(real t_in, real t_out) const;
+    //branch-free TauIndex(t_in[i], t_out[i]) of n pairs, so that the loop can be vectorized
+    void TauIndex(int n, const real* t_in, const real* t_out, int* bin) const;
     real IndexToTau(int TauIndex) const;
 
+    //the space points are the displacement classes with a point group, (SubIn*SublatVol+SubOut)*Vol+Coordi otherwise
+    int NSpacePoint() const;
+    int SpacePoint(int SubIn, int SubOut, int Coordi) const
+    {
+        if (Lat.HasPointGroup())
+            return Lat.DisplacementClass(SubIn, SubOut, Coordi);
+        return (SubIn * Lat.SublatVol + SubOut) * Lat.Vol + Coordi;
+    }
+    //store only the space points with InRange[point], with SUB1=SUB2=1 and one VOL element per point in range
+    void SetRange(const std::vector<bool>& InRange);
+    //InRange of SetRange, empty if every space point is stored
+    std::vector<bool> GetRange() const;
+    bool HasRange() const
+    {
+        return !_Slot.empty();
+    }
+    bool IsInRange(const Site& rin, const Site& rout) const
+    {
+        return _Slot.empty() || _Slot[SpacePoint(rin.Sublattice, rout.Sublattice, Lat.CoordiIndex(rin, rout))] >= 0;
+    }
+
 protected:
     void _UpdateCache();
+    //offset of the sublattices and the displacement, or of its class if the lattice has a point group; -1 out of the range
+    int _SpaceIndex(int SubIn, int SubOut, int Coordi, const uint* Cache) const
+    {
+        if (!_Slot.empty()) {
+            int slot = _Slot[SpacePoint(SubIn, SubOut, Coordi)];
+            return slot < 0 ? -1 : slot * Cache[VOL];
+        }
+        if (Lat.HasPointGroup())
+            return Lat.DisplacementClass(SubIn, SubOut, Coordi) * Cache[VOL];
+        return SubIn * Cache[SUB1] + SubOut * Cache[SUB2] + Coordi * Cache[VOL];
+    }
+    //VOL element of each space point in range, -1 for the others; empty if the map has no range
+    std::vector<int> _Slot;
     uint _Shape[SMOOTH_T_SIZE];
     uint _CacheDeltaT[DELTA_T_SIZE];
     uint _CacheSmoothT[SMOOTH_T_SIZE];
@@ -63,6 +102,10 @@ class IndexMapSPIN2 : public IndexMap {
 public:
     IndexMapSPIN2(real Beta, uint MaxTauBin, const Lattice& Lat, TauSymmetry Symmetry);
     static bool IsSameSpin(int spindex);
+    //spins of each end in the arrays of dyson/weight.py
+    static const int FullSpin = 2;
+    //index into the stored [SP1, SUB1, SP2, SUB2, VOL] of a point of the arrays of dyson/weight.py
+    int StoredIndex(int SpinIn, int SubIn, int SpinOut, int SubOut, int Coordi) const;
     uint GetIndex(spin in, spin out,
                   const Site& rin, const Site& rout,
                   real tin, real tout) const;
@@ -73,6 +116,16 @@ private:
     static int SpinIndex(spin SpinIn, spin SpinOut);
 };
 
+/**
+*  In SPIN_CONSERVED builds only the spin channels with in[IN]+out[IN]==in[OUT]+out[OUT] are stored:
+*  the SP1 axis holds the Channels conserved channels, in the order of GetConservedSpinTuple("FourSpins")
+*  in dyson/weight.py, and the SP2 axis has a single element. Unconserved spins are mapped past the
+*  end of the array, where the arrays of W keep MaxTauBin zeros (ZeroPadding).
+*  If the lattice has a point group, the SUB1, SUB2 and VOL axes of all maps hold the NClass displacement
+*  classes instead, with SUB1=SUB2=1 and VOL=NClass.
+*  A map with a range (SetRange) stores only the space points in range; the others are mapped to a second
+*  block of MaxTauBin elements after the zero padding of unconserved spins.
+*/
 class IndexMapSPIN4 : public IndexMap {
 public:
     IndexMapSPIN4(real Beta, uint MaxTauBin, const Lattice& Lat, TauSymmetry Symmetry);
@@ -83,6 +136,24 @@ public:
     uint GetIndex(const spin* in, const spin* out,
                   const Site& rin, const Site& rout) const;
 
+    static const int Channels = 6;
+    static const int FullSpin = 4;
+    static bool IsCompact();
+    //index into the stored [SP1, SUB1, SP2, SUB2, VOL] of a point of the arrays of dyson/weight.py, -1 if it is not stored
+    int StoredIndex(int SpinIndexIn, int SubIn, int SpinIndexOut, int SubOut, int Coordi) const;
+    //conserved channel of the spins, -1 if the spin is not conserved along the W line
+    static int Channel(const spin* in, const spin* out);
+    static int Channel(int SpinIndexIn, int SpinIndexOut);
+    //spin pair indexes (Spin[IN]*SPIN+Spin[OUT]) of both ends of a conserved channel
+    static void ChannelToSpinIndex(int Channel, int& SpinIndexIn, int& SpinIndexOut);
+    //elements an array needs after its end to be looked up with unconserved spins (zeros) and out of the range
+    uint ZeroPadding() const;
+    //first element of the block looked up out of the range, relative to the end of the array
+    uint OutOfRangeOffset() const
+    {
+        return MaxTauBin;
+    }
+
 private:
     static int SpinIndex(const spin* Spin);
     static int SpinIndex(spin SpinInIn, spin SpinInOut, spin SpinOutIn, spin SpinOutOut);
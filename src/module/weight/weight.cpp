@@ -17,6 +17,7 @@ using namespace para;
 weight::Weight::Weight(bool IsAllSymmetric)
 {
     _IsAllSymmetric = IsAllSymmetric;
+    _IsGWShared = false;
     Sigma = nullptr;
     Polar = nullptr;
     G = nullptr;
@@ -27,8 +28,10 @@ weight::Weight::~Weight()
 {
     delete Sigma;
     delete Polar;
-    delete G;
-    delete W;
+    if (!_IsGWShared) {
+        delete G;
+        delete W;
+    }
 }
 /**
 *  Build G, W, Sigma, Polar from file, you may use flag weight::GW and weight::SigmaPolar to control which group to load. Notice those in unflaged group will remain the same.
@@ -110,14 +113,33 @@ void weight::Weight::SetDiagCounter(const ParaMC &para)
     W->BuildTest();
 }
 
+/**
+*  Several Markov chains in the same process only read G and W, so they can point to the
+*  same GClass/WClass objects; the Weight which allocated them keeps the ownership.
+*/
+void weight::Weight::ShareGW(const Weight &source)
+{
+    ASSERT_ALLWAYS(source.G != nullptr && source.W != nullptr, "G and W of the source are not allocated yet!");
+    if (!_IsGWShared) {
+        delete G;
+        delete W;
+    }
+    G = source.G;
+    W = source.W;
+    _IsGWShared = true;
+}
+
 void weight::Weight::_AllocateGW(const ParaMC &para)
 {
     //make sure old Sigma/Polar/G/W are released before assigning new memory
-    delete G;
+    if (!_IsGWShared) {
+        delete G;
+        delete W;
+    }
+    _IsGWShared = false;
     auto symmetry = _IsAllSymmetric ? TauSymmetric : TauAntiSymmetric;
     G = new weight::GClass(para.Lat, para.Beta, para.MaxTauBin, symmetry);
-    delete W;
-    W = new weight::WClass(para.Lat, para.Beta, para.MaxTauBin);
+    W = new weight::WClass(para.Lat, para.Beta, para.MaxTauBin, para.WCutoff, para.WThreshold);
 }
 
 void weight::Weight::_AllocateSigmaPolar(const ParaMC &para)
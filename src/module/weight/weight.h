@@ -34,6 +34,7 @@ public:
     Weight(bool IsAllSymmetric = false);
     ~Weight();
     bool _IsAllSymmetric;
+    bool _IsGWShared;
     SigmaClass* Sigma;
     PolarClass* Polar;
     GClass* G;
@@ -45,6 +46,8 @@ public:
     bool FromDict(const Dictionary&, flag, const para::ParaMC&);
     Dictionary ToDict(flag);
     void Anneal(const para::ParaMC&);
+    //use the read-only G/W of another Weight instead of owning a copy
+    void ShareGW(const Weight&);
 
 private:
     void _AllocateGW(const para::ParaMC&);
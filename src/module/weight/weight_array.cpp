@@ -11,56 +11,105 @@
 #include "utility/dictionary.h"
 #include "index_map.h"
 #include <math.h>
+#include <type_traits>
 
 using namespace std;
 
 namespace weight {
-template <uint DIM>
-void WeightArray<DIM>::Assign(const Complex& c)
+//a Complex array is wrapped without a copy, other storages are widened into an array of their own
+Python::ArrayObject ToArray(Complex* data, const uint* shape, uint dim, uint)
+{
+    return Python::ArrayObject(data, shape, dim);
+}
+
+template <typename Storage>
+Python::ArrayObject ToArray(Storage* data, const uint* shape, uint dim, uint size)
+{
+    auto array = Python::ArrayObject::Zeros(vector<uint>(shape, shape + dim));
+    Complex* target = array.Data<Complex>();
+    for (uint i = 0; i < size; i++)
+        target[i] = Complex(data[i]);
+    return array;
+}
+
+//the imaginary parts are negligible against the real parts
+bool IsReal(const Complex* data, uint size)
+{
+    real MaxRe = 0.0, MaxIm = 0.0;
+    for (uint i = 0; i < size; i++) {
+        MaxRe = max(MaxRe, fabs(data[i].Re));
+        MaxIm = max(MaxIm, fabs(data[i].Im));
+    }
+    return MaxIm <= 1.0e-10 * MaxRe;
+}
+
+inline Complex RoundToFloat(const Complex& c)
+{
+    return Complex(float(c.Re), float(c.Im));
+}
+inline real RoundToFloat(real x)
+{
+    return float(x);
+}
+inline ComplexFloat RoundToFloat(const ComplexFloat& c)
+{
+    return c;
+}
+inline float RoundToFloat(float x)
+{
+    return x;
+}
+
+template <uint DIM, typename Storage>
+void WeightArray<DIM, Storage>::Assign(const Complex& c)
 {
     ASSERT_ALLWAYS(IsAllocated, "Array should be allocated first!");
     for (uint i = 0; i < _Size; i++)
-        _Data[i] = c;
+        Narrow(c, _Data[i]);
 }
-template <uint DIM>
-void WeightArray<DIM>::Assign(const Complex* source)
+template <uint DIM, typename Storage>
+void WeightArray<DIM, Storage>::Assign(const Complex* source)
 {
     ASSERT_ALLWAYS(IsAllocated, "Array should be allocated first!");
-    if (_Data == source)
+    if ((const void*)_Data == (const void*)source)
         return;
-    std::copy(source, source + _Size, _Data);
+    for (uint i = 0; i < _Size; i++)
+        Narrow(source[i], _Data[i]);
 }
 
-template <uint DIM>
-void WeightArray<DIM>::Assign(const Complex* source, uint size)
+template <uint DIM, typename Storage>
+void WeightArray<DIM, Storage>::Assign(const Complex* source, uint size)
 {
     ASSERT_ALLWAYS(IsAllocated, "Array should be allocated first!");
-    if (_Data == source)
+    if ((const void*)_Data == (const void*)source)
         return;
-    std::copy(source, source + size, _Data);
+    for (uint i = 0; i < size; i++)
+        Narrow(source[i], _Data[i]);
 }
 
-template <uint DIM>
-void WeightArray<DIM>::Allocate(const uint* Shape_, const std::string Name)
+template <uint DIM, typename Storage>
+void WeightArray<DIM, Storage>::Allocate(const uint* Shape_, const std::string Name, uint Padding)
 {
     _Name = Name;
     if (IsAllocated)
         Free();
     std::copy(Shape_, Shape_ + DIM, _Shape);
     _Size = 1;
-    for (auto i = 0; i < DIM; i++) {
+    for (uint i = 0; i < DIM; i++) {
         _Size *= _Shape[i];
     }
-    _Data = new Complex[_Size];
+    _Data = new Storage[_Size + Padding];
     if (_Data == nullptr) {
         THROW_ERROR(MemoryException, "Fail to allocate array!");
         IsAllocated = false;
     }
+    for (uint i = _Size; i < _Size + Padding; i++)
+        Narrow(Complex(0.0, 0.0), _Data[i]);
     IsAllocated = true;
 }
 
-template <uint DIM>
-void WeightArray<DIM>::Free()
+template <uint DIM, typename Storage>
+void WeightArray<DIM, Storage>::Free()
 {
     if (IsAllocated) {
         delete[] _Data;
@@ -68,25 +117,41 @@ void WeightArray<DIM>::Free()
     }
 }
 
-template <uint DIM>
-bool WeightArray<DIM>::FromDict(const Dictionary& dict)
+template <uint DIM, typename Storage>
+bool WeightArray<DIM, Storage>::FromDict(const Dictionary& dict)
 {
     ASSERT_ALLWAYS(IsAllocated, "Array should be allocated first!");
     Python::ArrayObject arr = dict.Get<Python::ArrayObject>(_Name);
     ASSERT_ALLWAYS(Equal(arr.Shape().data(), GetShape(), GetDim()), "Shape should match!");
+    //real storages keep only the real parts, so the weights have to be real
+    if (is_floating_point<Storage>::value)
+        ASSERT_ALLWAYS(IsReal(arr.Data<Complex>(), _Size), _Name << " is not real, build without REAL_WEIGHT!");
     Assign(arr.Data<Complex>());
     return true;
 }
 
-template <uint DIM>
-Dictionary WeightArray<DIM>::ToDict()
+template <uint DIM, typename Storage>
+Dictionary WeightArray<DIM, Storage>::ToDict()
 {
     Dictionary dict;
-    dict[_Name] = Python::ArrayObject(_Data, GetShape(), GetDim());
+    dict[_Name] = ToArray();
     return dict;
 }
 
-template class WeightArray<DELTA_T_SIZE>;
-template class WeightArray<SMOOTH_T_SIZE>;
+template <uint DIM, typename Storage>
+Python::ArrayObject WeightArray<DIM, Storage>::ToArray()
+{
+    return weight::ToArray(_Data, GetShape(), GetDim(), GetSize());
+}
+
+template <uint DIM, typename Storage>
+void WeightArray<DIM, Storage>::RoundToFloat()
+{
+    for (uint i = 0; i < _Size; i++)
+        _Data[i] = weight::RoundToFloat(_Data[i]);
+}
+
+template class WeightArray<DELTA_T_SIZE, WeightStorage>;
+template class WeightArray<SMOOTH_T_SIZE, WeightStorage>;
 template class WeightArray<SMOOTH_T_SIZE + 1>;
 }
\ No newline at end of file
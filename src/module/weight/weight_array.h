@@ -13,6 +13,9 @@
 #include <string>
 
 class Dictionary;
+namespace Python {
+class ArrayObject;
+}
 namespace weight {
 
 enum SpinNum {
@@ -23,7 +26,69 @@ enum SpinNum {
 const std::string SMOOTH = "SmoothT";
 const std::string DELTA = "DeltaT";
 
-template <uint DIM>
+/**
+*  Complex number kept as two floats, it is widened to Complex on every lookup,
+*  so that only the storage is in single precision
+*/
+class ComplexFloat {
+public:
+    float Re;
+    float Im;
+    ComplexFloat()
+        : Re(0.0)
+        , Im(0.0)
+    {
+    }
+    ComplexFloat(const Complex& c)
+        : Re(float(c.Re))
+        , Im(float(c.Im))
+    {
+    }
+    operator Complex() const { return Complex(Re, Im); }
+};
+
+//cmake -DSINGLE_PRECISION_WEIGHT=ON to store the tables of G and W in single precision; estimators always accumulate in double
+#if defined(REAL_WEIGHT) && defined(SINGLE_PRECISION_WEIGHT)
+typedef float WeightStorage;
+#elif defined(REAL_WEIGHT)
+typedef real WeightStorage;
+#elif defined(SINGLE_PRECISION_WEIGHT)
+typedef ComplexFloat WeightStorage;
+#else
+typedef Complex WeightStorage;
+#endif
+
+using ::RealPart;
+using ::ImagPart;
+inline real RealPart(const ComplexFloat& c)
+{
+    return c.Re;
+}
+
+inline real ImagPart(const ComplexFloat& c)
+{
+    return c.Im;
+}
+
+//a Complex kept in each storage, the real storages drop the imaginary part
+inline void Narrow(const Complex& c, Complex& s)
+{
+    s = c;
+}
+inline void Narrow(const Complex& c, ComplexFloat& s)
+{
+    s = ComplexFloat(c);
+}
+inline void Narrow(const Complex& c, real& s)
+{
+    s = c.Re;
+}
+inline void Narrow(const Complex& c, float& s)
+{
+    s = float(c.Re);
+}
+
+template <uint DIM, typename Storage = Amplitude>
 class WeightArray {
 public:
     WeightArray()
@@ -32,7 +97,8 @@ public:
     WeightArray(const WeightArray& source) = delete;
     WeightArray& operator=(const WeightArray& c) = delete;
     ~WeightArray() { Free(); };
-    void Allocate(const uint* shape, const std::string Name);
+    //Padding zeros are kept after the array, outside of its shape
+    void Allocate(const uint* shape, const std::string Name, uint Padding = 0);
     void Free();
     void Copy(const WeightArray& c);
     void Assign(const Complex& c);
@@ -42,12 +108,17 @@ public:
     uint GetDim() const { return DIM; }
     uint GetSize() const { return _Size; }
     const uint* GetShape() const { return _Shape; }
-    Complex& operator[](uint Index) { return _Data[Index]; }
-    const Complex& operator()(uint Index) const { return _Data[Index]; }
-    Complex* Data() { return _Data; }
+    Storage& operator[](uint Index) { return _Data[Index]; }
+    Amplitude operator()(uint Index) const { return _Data[Index]; }
+    Storage* Data() { return _Data; }
+    const Storage* Data() const { return _Data; }
+    //round every element to the precision of ComplexFloat
+    void RoundToFloat();
 
     bool FromDict(const Dictionary&);
     Dictionary ToDict();
+    //the array as Complex, a Complex array is wrapped without a copy
+    Python::ArrayObject ToArray();
 
     template <typename T>
     WeightArray& operator+=(const T& rhs)
@@ -79,7 +150,7 @@ public:
     }
 
 protected:
-    Complex* _Data;
+    Storage* _Data;
     bool IsAllocated;
     uint _Shape[DIM];
     uint _Size;
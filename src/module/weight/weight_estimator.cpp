@@ -47,7 +47,7 @@ void WeightEstimator::MeasureNorm(real weight)
     _NormAccu += weight;
 }
 
-void WeightEstimator::Measure(uint WeightIndex, int Order, Complex weight)
+void WeightEstimator::Measure(uint WeightIndex, int Order, Amplitude weight)
 {
     if (DEBUGMODE && Order < 1)
         LOG_ERROR("Too small order=" << Order);
@@ -69,6 +69,16 @@ void WeightEstimator::SqueezeStatistics(real factor)
     _WeightAccu *= 1.0 / factor;
 }
 
+void WeightEstimator::MergeStatistics(const WeightEstimator& source)
+{
+    ASSERT_ALLWAYS(_WeightAccu.GetSize() == source._WeightAccu.GetSize(), "Shape should match!");
+    _NormAccu += source._NormAccu;
+    Amplitude* target = _WeightAccu.Data();
+    const Amplitude* data = source._WeightAccu.Data();
+    for (uint i = 0; i < _WeightAccu.GetSize(); i++)
+        target[i] += data[i];
+}
+
 /**********************   Weight IO ****************************************/
 
 bool WeightEstimator::FromDict(const Dictionary& dict)
@@ -88,6 +98,6 @@ Dictionary WeightEstimator::ToDict()
     Dictionary dict;
     dict["Norm"] = _Norm;
     dict["NormAccu"] = _NormAccu;
-    dict["WeightAccu"] = Python::ArrayObject(_WeightAccu.Data(), _WeightAccu.GetShape(), _WeightAccu.GetDim());
+    dict["WeightAccu"] = _WeightAccu.ToArray();
     return dict;
 }
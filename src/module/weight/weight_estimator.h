@@ -28,10 +28,12 @@ public:
     void Anneal(real Beta);
 
     void MeasureNorm(real weight);
-    void Measure(uint WeightIndex, int Order, Complex Weight);
+    void Measure(uint WeightIndex, int Order, Amplitude Weight);
 
     void ClearStatistics();
     void SqueezeStatistics(real factor);
+    //add the accumulated statistics of another estimator with the same shape
+    void MergeStatistics(const WeightEstimator&);
     //    std::string PrettyString();
     bool FromDict(const Dictionary&);
     Dictionary ToDict();
@@ -14,6 +14,7 @@
 #include "estimator/estimator.h"
 #include "module/weight/component.h"
 #include "utility/dictionary.h"
+#include "utility/alias_table.h"
 
 using namespace std;
 
@@ -28,6 +29,7 @@ int RunTest()
     //TestTimer();  //Test the timer
     //TestRNG();
     //TestArray();
+    TEST(TestAliasTable);
     TEST(TestLattice);
     TEST(diag::TestDiagram);
     TEST(mc::TestMarkov);
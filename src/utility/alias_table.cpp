@@ -0,0 +1,71 @@
+//
+//  alias_table.cpp
+//  Feynman_Simulator
+//
+
+#include "alias_table.h"
+#include "utility/abort.h"
+
+using namespace std;
+
+AliasTable::AliasTable()
+    : _Size(0)
+{
+}
+
+void AliasTable::Build(const vector<real>& weights)
+{
+    Build(weights.data(), weights.size());
+}
+
+void AliasTable::Build(const real* weights, int size)
+{
+    ASSERT_ALLWAYS(size > 0, "AliasTable can not be empty!");
+    real sum = 0.0;
+    for (int i = 0; i < size; i++) {
+        ASSERT_ALLWAYS(weights[i] >= 0.0, "weight " << i << " is negative!");
+        sum += weights[i];
+    }
+    ASSERT_ALLWAYS(sum > 0.0, "at least one weight should be positive!");
+
+    _Size = size;
+    _Prob.assign(size, 0.0);
+    _Threshold.assign(size, 1.0);
+    _Alias.assign(size, 0);
+
+    vector<int> small, large;
+    for (int i = 0; i < size; i++) {
+        _Prob[i] = weights[i] / sum;
+        _Alias[i] = i;
+        _Threshold[i] = _Prob[i] * size;
+        if (_Threshold[i] < 1.0)
+            small.push_back(i);
+        else
+            large.push_back(i);
+    }
+    while (!small.empty() && !large.empty()) {
+        int s = small.back(), l = large.back();
+        small.pop_back();
+        _Alias[s] = l;
+        _Threshold[l] -= 1.0 - _Threshold[s];
+        if (_Threshold[l] < 1.0) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    //whatever is left is 1.0 up to round-off error, except a zero weight left over by round-off,
+    //which always goes to its alias, the largest weight
+    int largest = 0;
+    for (int i = 1; i < size; i++)
+        if (_Prob[i] > _Prob[largest])
+            largest = i;
+    for (auto i : small)
+        if (_Prob[i] > 0.0)
+            _Threshold[i] = 1.0;
+        else {
+            _Threshold[i] = 0.0;
+            _Alias[i] = largest;
+        }
+    for (auto i : large)
+        _Threshold[i] = 1.0;
+}
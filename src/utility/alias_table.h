@@ -0,0 +1,45 @@
+//
+//  alias_table.h
+//  Feynman_Simulator
+//
+
+#ifndef __Feynman_Simulator__alias_table__
+#define __Feynman_Simulator__alias_table__
+
+#include <vector>
+#include "utility/convention.h"
+#include "utility/rng.h"
+
+/**
+*  Walker's alias method: draw an integer in [0, Size) according to a discrete distribution
+*  with one random number, O(1) time per sample
+*/
+class AliasTable {
+public:
+    AliasTable();
+    //weights do not need to be normalized, but at least one of them should be positive
+    void Build(const real* weights, int size);
+    void Build(const std::vector<real>& weights);
+
+    int Size() const { return _Size; }
+    //the normalized probability to pick index
+    real Prob(int index) const { return _Prob[index]; }
+
+    inline int Sample(RandomFactory& RNG) const
+    {
+        real x = RNG.urn() * _Size;
+        int i = int(x);
+        if (i >= _Size)
+            i = _Size - 1;
+        return (x - i < _Threshold[i]) ? i : _Alias[i];
+    }
+
+private:
+    int _Size;
+    std::vector<real> _Prob;
+    std::vector<real> _Threshold;
+    std::vector<int> _Alias;
+};
+
+int TestAliasTable();
+#endif /* defined(__Feynman_Simulator__alias_table__) */
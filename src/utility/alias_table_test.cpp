@@ -0,0 +1,42 @@
+//
+//  alias_table_test.cpp
+//  Feynman_Simulator
+//
+
+#include "alias_table.h"
+#include "sput.h"
+#include "utility.h"
+#include <math.h>
+
+using namespace std;
+
+void Test_Alias_Distribution()
+{
+    RandomFactory RNG(519180543);
+    real weights[5] = { 1.0, 0.0, 3.0, 0.5, 5.5 };
+    AliasTable Table;
+    Table.Build(weights, 5);
+    sput_fail_unless(Equal(Table.Prob(2), 0.3), "normalized probability");
+
+    const int N = 1000000;
+    real hist[5] = { 0.0 };
+    for (int i = 0; i < N; i++)
+        hist[Table.Sample(RNG)] += 1.0;
+    sput_fail_unless(Equal(hist[1], 0.0), "zero weight is never picked");
+    bool flag = true;
+    for (int i = 0; i < 5; i++) {
+        real p = Table.Prob(i);
+        if (fabs(hist[i] / N - p) > 5.0 * sqrt(p * (1.0 - p) / N) + 1.0e-12)
+            flag = false;
+    }
+    sput_fail_unless(flag, "sampled frequency agrees with the probability");
+}
+
+int TestAliasTable()
+{
+    sput_start_testing();
+    sput_enter_suite("Test AliasTable...");
+    sput_run_test(Test_Alias_Distribution);
+    sput_finish_testing();
+    return sput_get_return_value();
+}
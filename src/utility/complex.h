@@ -153,4 +153,62 @@ inline Complex pow(const Complex& z, real u)
     return exp(logr * u) * Complex(cos(theta), sin(theta));
 }
 
+//the real numbers of the weights of REAL_WEIGHT builds, where the phase of a weight is its sign
+inline real mod2(real x)
+{
+    return x * x;
+}
+
+inline real mod(real x)
+{
+    return fabs(x);
+}
+
+inline real phase(real x)
+{
+    return x > 0.0 ? 1.0 : (x < 0.0 ? -1.0 : 0.0);
+}
+
+inline bool IsZero(real x)
+{
+    return x == 0.0;
+}
+
+inline real RealPart(const Complex& c)
+{
+    return c.Re;
+}
+
+inline real ImagPart(const Complex& c)
+{
+    return c.Im;
+}
+
+inline real RealPart(real x)
+{
+    return x;
+}
+
+inline real ImagPart(real)
+{
+    return 0.0;
+}
+
+//cmake -DREAL_WEIGHT=ON for models whose G and W are real, all weights are then kept as real numbers
+#ifdef REAL_WEIGHT
+typedef real Amplitude;
+#else
+typedef Complex Amplitude;
+#endif
+
+//the weight with the given real and imaginary parts, the imaginary part is dropped for real weights
+inline Amplitude ToAmplitude(real re, real im)
+{
+#ifdef REAL_WEIGHT
+    return re;
+#else
+    return Complex(re, im);
+#endif
+}
+
 #endif
@@ -36,10 +36,18 @@ const int IN = 0;
 const int OUT = 1;
 #define INVERSE(x) (1 - x)
 
-const int MAX_ORDER = 10;
+//the dimension and the order cap are fixed at compile time, cmake builds one engine for every pair in ENGINES
+#ifndef DIMENSION
+#define DIMENSION 2
+#endif
+#ifndef MAX_DIAGRAM_ORDER
+#define MAX_DIAGRAM_ORDER 10
+#endif
+
+const int MAX_ORDER = MAX_DIAGRAM_ORDER;
 
 //define your lattice here
 
-const int D = 2;
+const int D = DIMENSION;
 
 #endif
@@ -100,6 +100,16 @@ void ArrayObject::_Construct(real* data, const uint* Shape, const int Dim)
     *this = Object(array);
 }
 
+ArrayObject ArrayObject::Zeros(const std::vector<uint>& Shape)
+{
+    vector<npy_intp> _Shape(Shape.begin(), Shape.end());
+    int TypeName = sizeof(Complex) == 8 ? NPY_COMPLEX64 : NPY_COMPLEX128;
+    PyObject* array = PyArray_ZEROS((int)_Shape.size(), _Shape.data(), TypeName, 0);
+    PropagatePyError();
+    ASSERT_ALLWAYS(array != nullptr, "Failed to create python array!");
+    return ArrayObject(array);
+}
+
 template <>
 Complex* ArrayObject::Data<Complex>()
 {
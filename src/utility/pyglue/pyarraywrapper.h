@@ -36,6 +36,8 @@ public:
     {
         _Construct(data, Shape, Dim);
     }
+    //a complex array of zeros, which owns its data unlike the arrays wrapping a pointer above
+    static ArrayObject Zeros(const std::vector<uint>& Shape);
     template <typename T>
     T* Data();
     std::vector<uint> Shape();
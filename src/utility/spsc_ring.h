@@ -0,0 +1,65 @@
+//
+//  spsc_ring.h
+//  Feynman_Simulator
+//
+
+#ifndef __Feynman_Simulator__spsc_ring__
+#define __Feynman_Simulator__spsc_ring__
+
+#include <atomic>
+#include "utility/convention.h"
+
+//size of a cache line, the two ends of the ring are padded onto different lines to avoid false sharing
+const int CACHE_LINE = 64;
+
+/**
+*  Lock-free ring buffer with exactly one producer thread and one consumer thread.
+*  Size must be a power of two; the ring holds at most Size elements.
+*/
+template <typename T, uint Size>
+class SpscRing {
+    static_assert((Size & (Size - 1)) == 0, "Size of SpscRing should be a power of two!");
+
+public:
+    SpscRing()
+        : _Head(0)
+        , _Tail(0)
+    {
+    }
+
+    //producer side, returns false if the ring is full
+    bool Push(const T& item)
+    {
+        uint tail = _Tail.load(std::memory_order_relaxed);
+        if (tail - _Head.load(std::memory_order_acquire) == Size)
+            return false;
+        _Buffer[tail & (Size - 1)] = item;
+        _Tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    //consumer side, returns false if the ring is empty
+    bool Pop(T& item)
+    {
+        uint head = _Head.load(std::memory_order_relaxed);
+        if (head == _Tail.load(std::memory_order_acquire))
+            return false;
+        item = _Buffer[head & (Size - 1)];
+        _Head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool IsEmpty() const
+    {
+        return _Head.load(std::memory_order_acquire) == _Tail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::atomic<uint> _Head;
+    char _PadHead[CACHE_LINE - sizeof(std::atomic<uint>)];
+    std::atomic<uint> _Tail;
+    char _PadTail[CACHE_LINE - sizeof(std::atomic<uint>)];
+    T _Buffer[Size];
+};
+
+#endif /* defined(__Feynman_Simulator__spsc_ring__) */
@@ -9,6 +9,11 @@
 #include <ctime>
 #include <iosfwd>
 #include <iomanip>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
 
 class timer {
     friend std::ostream& operator<<(std::ostream& os, timer& t);
@@ -46,6 +51,19 @@ public:
 
 }; // class timer
 
+/**
+*  cheap time stamp to profile short pieces of code: CPU cycles on x86, nanoseconds elsewhere
+*/
+inline unsigned long long ReadCycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
 int TestTimer();
 
 #endif //__timer_H_
@@ -41,7 +41,7 @@ public:
             _Array[j] = value;
     }
 
-    Vec(T* value)
+    Vec(const T* value)
     {
         for (int j = 0; j < D; j++)
             _Array[j] = value[j];